@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Asynchronous signal handlers and functions of the AMD extension.
+ */
+
+#ifndef HSA_RUNTIME_ASYNCEVENTS_HH
+#define HSA_RUNTIME_ASYNCEVENTS_HH
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hsa.h"
+
+namespace phsa {
+
+class Signal;
+
+// Runs the handlers registered with hsa_amd_signal_async_handler and the
+// functions queued with hsa_amd_async_function in a single event thread,
+// started on first use. The thread sleeps in SignalEvents while none of
+// the handler conditions hold and no functions are queued, and waits for
+// Wakeup instead while there are no handlers at all.
+class AsyncEvents {
+public:
+  typedef bool (*Handler)(hsa_signal_value_t Value, void *Arg);
+  typedef void (*Function)(void *Arg);
+
+  ~AsyncEvents();
+
+  // Calls H with the value of S each time Condition holds for it, until H
+  // returns false.
+  void addHandler(Signal &S, hsa_signal_condition_t Condition,
+                  hsa_signal_value_t Value, Handler H, void *Arg);
+
+  // Calls F once in the event thread.
+  void addFunction(Function F, void *Arg);
+
+  // Stops the event thread. The handlers and functions not yet run are
+  // dropped.
+  void shutDown();
+
+private:
+  struct SignalHandler {
+    Signal *S;
+    hsa_signal_condition_t Condition;
+    hsa_signal_value_t Value;
+    Handler H;
+    void *Arg;
+  };
+
+  struct QueuedFunction {
+    Function F;
+    void *Arg;
+  };
+
+  void start();
+  void run();
+
+  // Registrations not yet picked up by the event thread.
+  std::vector<SignalHandler> NewHandlers;
+  std::vector<QueuedFunction> Functions;
+  std::mutex Lock;
+  std::condition_variable Wakeup;
+  bool ShuttingDown = false;
+  std::thread EventThread;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_ASYNCEVENTS_HH
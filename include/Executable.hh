@@ -24,12 +24,14 @@
 #define HSA_RUNTIME_EXECUTABLE_HH
 
 #include <list>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
 #include "hsa.h"
 #include "HSAObjectMapping.hh"
 #include "HSAReturnValue.hh"
+#include "SymbolIndex.hh"
 
 namespace phsa {
 
@@ -75,11 +77,15 @@ struct IndirectFunctionCall : public Symbol {
   uint32_t FunctionCallConvention;
 };
 
+// Maps symbol names to their addresses.
+typedef std::unordered_map<std::string, uint64_t> SymbolAddressIndex;
+
 // Executable is a base class that holds the code objects and defined symbols.
 // Subclasses must implement the code object loading. In addition, the symbols
 // of the loaded code objects must be registered using the protected
-// interface. Sub classes may use the `DefinedSymbols` index to query
-// for the defined symbol addresses.
+// interface, either at load time or on demand by overriding `loadSymbol`
+// and `loadPendingSymbols`. Sub classes may use the `DefinedSymbols` index
+// to query for the defined symbol addresses.
 //
 // See `src/Finalizer/GCC/ELFExecutable.[cc|hh] for an example implementation.
 class Executable : public HSAObjectMapping<Executable, hsa_executable_t> {
@@ -96,24 +102,37 @@ public:
                                           const hsa_code_object_t CodeObject,
                                           const char *Options) = 0;
 
-  virtual Symbol const *getSymbol(std::string const &Name) const {
-    auto It = SymbolsByName.find(Name);
-    if (It != SymbolsByName.end()) {
-      return It->second;
-    }
-
-    return nullptr;
+  // Looks up a symbol by its HSA name, optionally qualified by a module
+  // name (see SymbolIndex).
+  virtual Symbol const *
+  getSymbol(boost::string_ref Name,
+            boost::string_ref ModuleName = boost::string_ref()) {
+    std::lock_guard<std::mutex> Lock(SymbolLock);
+    Symbol *S = SymbolsByName.find(Name, ModuleName);
+    if (S == nullptr)
+      S = loadSymbol(Name, ModuleName);
+    return S;
   };
 
+  // Registers all the symbols not loaded yet.
+  void loadSymbols() {
+    std::lock_guard<std::mutex> Lock(SymbolLock);
+    loadPendingSymbols();
+  }
+
   virtual void freeze() { IsFrozen = true; }
 
   virtual bool isFrozen() const { return IsFrozen; }
 
   using symbol_iterator = std::list<Symbol *>::iterator;
   using const_symbol_iterator = std::list<Symbol *>::const_iterator;
-  symbol_iterator symbol_begin() { return Symbols.begin(); }
+  symbol_iterator symbol_begin() {
+    loadSymbols();
+    return Symbols.begin();
+  }
   symbol_iterator symbol_end() { return Symbols.end(); }
 
+  // Iterates only the symbols loaded so far.
   const_symbol_iterator symbol_cbegin() const { return Symbols.cbegin(); }
   const_symbol_iterator symbol_cend() const { return Symbols.cend(); }
 
@@ -125,19 +144,29 @@ public:
   }
 
 protected:
+  // Registers a symbol not loaded yet, if the executable has one with the
+  // name. Called with SymbolLock held.
+  virtual Symbol *loadSymbol(boost::string_ref, boost::string_ref) {
+    return nullptr;
+  }
+
+  // Registers all the symbols not loaded yet. Called with SymbolLock held.
+  virtual void loadPendingSymbols() {}
+
   void registerSymbol(Symbol *S) {
     Symbols.push_back(S);
-    SymbolsByName[S->Name] = S;
+    SymbolsByName.insert(S);
   }
 
-  typedef std::unordered_map<std::string, uint64_t> SymbolAddressIndex;
   // The host defined symbols that should be set when the program
   // is loaded.
   SymbolAddressIndex DefinedSymbols;
 
 private:
   std::list<Symbol *> Symbols;
-  std::unordered_map<std::string, Symbol *> SymbolsByName;
+  SymbolIndex SymbolsByName;
+  // Serializes the lookups with loading symbols on demand.
+  std::mutex SymbolLock;
   bool IsFrozen;
 };
 
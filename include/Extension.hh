@@ -34,9 +34,15 @@ class Extension {
 public:
   using Identifier = uint64_t;
 
+  virtual ~Extension() {}
+
   virtual Identifier getIdentifier() const = 0;
   virtual Version getVersion() const = 0;
   virtual void fillExtensionTable(void *table) const = 0;
+
+  // Called before the runtime objects the extension might still be using
+  // are destroyed.
+  virtual void shutDown() {}
 };
 
 #endif // HSA_RUNTIME_EXTENSION_HH
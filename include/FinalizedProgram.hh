@@ -29,6 +29,9 @@
 #include <hsa.h>
 #include <hsa_ext_finalize.h>
 #include <libelf.h>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "HSAObjectMapping.hh"
 #include "gcc-phsa.h"
 #include "Executable.hh"
@@ -43,9 +46,14 @@ namespace phsa {
 class FinalizedProgram
     : public HSAObjectMapping<FinalizedProgram, hsa_code_object_t> {
 public:
+  // Takes the ownership of the new[] allocated ElfBlob.
   FinalizedProgram(char *ElfBlob, size_t ElfSize, hsa_isa_t ISA,
                    hsa_machine_model_t MM, hsa_profile_t P,
                    hsa_default_float_rounding_mode_t RM);
+  // Shares the ElfBlob with the other programs finalized to the same ELF.
+  FinalizedProgram(std::shared_ptr<char> ElfBlob, size_t ElfSize,
+                   hsa_isa_t ISA, hsa_machine_model_t MM, hsa_profile_t P,
+                   hsa_default_float_rounding_mode_t RM);
   virtual ~FinalizedProgram();
 
   /// The final finalized binary image in the disk, if any produced so far.
@@ -54,12 +62,13 @@ public:
   void setBinFileName(std::string Fname) { BinaryFileName = Fname; }
 
   // The ELF blob in memory that can be used as a symbol index.
-  char *elfBlob() const { return ELFBlob; }
+  char *elfBlob() const { return ELFBlob.get(); }
+  std::shared_ptr<char> sharedElfBlob() const { return ELFBlob; }
   // The size of the ELF blob in bytes.
   size_t elfSize() const { return ELFSize; }
 
-  virtual std::size_t serializedSize() const = 0;
-  virtual void serializeTo(uint8_t *Buffer) const = 0;
+  // Returns the serialized code object.
+  virtual std::vector<uint8_t> serialize() const = 0;
 
   hsa_machine_model_t getMachineModel() { return MachineModel; }
   hsa_profile_t getProfile() { return Profile; }
@@ -81,17 +90,26 @@ public:
   virtual uint64_t symbolAddress(std::string SymbolName,
                                  Elf64_Sym *Symbol = nullptr) = 0;
 
-  virtual Symbol *findSymbol(std::string const &SymbolName);
-  virtual phsa_descriptor *findDescriptor(std::string const &SymbolName);
+  // Looks up a symbol by its HSA name, "&name" or "&module::&name".
+  virtual Symbol *findSymbol(boost::string_ref SymbolName);
+  // Looks up a symbol created for this program so far.
+  Symbol *findLoadedSymbol(boost::string_ref SymbolName) const {
+    return SymbolsByName.find(SymbolName);
+  }
+  // Looks up the descriptor of a function by its ELF symbol name.
+  virtual phsa_descriptor *findDescriptor(boost::string_ref SymbolName);
 
-  virtual void addSymbol(Symbol *Symbol) { Symbols.push_back(Symbol); }
+  virtual void addSymbol(Symbol *Symbol) {
+    Symbols.push_back(Symbol);
+    SymbolsByName.insert(Symbol);
+  }
 
   using symbol_iterator = std::list<Symbol *>::iterator;
 
   using func_descriptor_iterator =
       std::unordered_map<std::string, phsa_descriptor *>::iterator;
 
-  symbol_iterator symbol_begin() { return Symbols.begin(); }
+  symbol_iterator symbol_begin();
   symbol_iterator symbol_end() { return Symbols.end(); }
 
   func_descriptor_iterator func_descriptors_begin() {
@@ -106,23 +124,51 @@ public:
   virtual void defineGlobalSymbolAddress(std::string SymbolName,
                                          uint64_t Addr) = 0;
 
-  void setExecutable(const Executable &Owner) { Parent = &Owner; }
+  // Returns the instance of the program to load to an executable with
+  // the given host definitions of the external global symbols, or nullptr
+  // on failure. The executables with the same definitions share an
+  // instance and its symbols. Each returned instance must be released
+  // once the executable is done with it.
+  virtual FinalizedProgram *
+  acquire(const SymbolAddressIndex &HostDefinitions) = 0;
+  virtual void release() = 0;
+
+  // Serializes creating the symbols of the program by the executables
+  // sharing it.
+  std::mutex &symbolLock() { return SymbolLock; }
+
+  // Adds and removes an executable the program is loaded to. The symbols
+  // loaded lazily are created through the executables.
+  void addExecutable(Executable &Owner);
+  void removeExecutable(const Executable &Owner);
+
+  // Returns true in case the symbols of the code objects should be loaded
+  // only when they are looked up (PHSA_LAZY_LOADING).
+  static bool lazyLoading();
 
 protected:
   // The symbols belonging to this code object.
   std::list<Symbol *> Symbols;
-  // The executable that includes this code object.
-  const Executable *Parent = nullptr;
+  SymbolIndex SymbolsByName;
+  std::mutex SymbolLock;
+  // The executables that include this code object.
+  std::vector<Executable *> Owners;
+  std::mutex OwnersLock;
 
   // This is set to false in case the loaded blob was found illegal.
   bool IsValid;
   std::string BinaryFileName;
   // The loaded ELF file in memory.
-  char *ELFBlob;
+  std::shared_ptr<char> ELFBlob;
   // The size of the ELF image.
   size_t ELFSize;
   // The function descriptors originating from GCC (see gcc-phsa.h). */
   std::unordered_map<std::string, phsa_descriptor *> FuncDescriptors;
+  // The FuncDescriptors entries by the hash of the name so that the
+  // lookups need no key object.
+  using FuncDescriptorEntry = std::pair<const std::string, phsa_descriptor *>;
+  std::unordered_multimap<std::size_t, const FuncDescriptorEntry *>
+      DescriptorsByHash;
 
   hsa_machine_model_t MachineModel;
   hsa_profile_t Profile;
@@ -23,10 +23,20 @@
 #ifndef HSA_RUNTIME_FINALIZER_HH
 #define HSA_RUNTIME_FINALIZER_HH
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "HSAReturnValue.hh"
 #include "hsa_ext_finalize.h"
 #include "Extension.hh"
 
+namespace phsa {
+class ThreadPool;
+}
+
 class Finalizer : public Extension {
 public:
   virtual Identifier getIdentifier() const { return 0; };
@@ -43,6 +53,49 @@ public:
   finalizeProgram(hsa_ext_program_t Program,
                   hsa_ext_control_directives_t ControlDirectives, hsa_isa_t ISA,
                   const char *VendorCompilerOptions) = 0;
+
+  using FinalizeCallback =
+      std::function<void(HSAReturnValue<hsa_code_object_s>)>;
+
+  // Finalizes the programs concurrently in the finalizer threads and
+  // returns once all of them have been finalized. finalizeProgram() must
+  // be reentrant for this.
+  std::vector<HSAReturnValue<hsa_code_object_s>>
+  finalizePrograms(const std::vector<hsa_ext_program_t> &Programs,
+                   hsa_ext_control_directives_t ControlDirectives,
+                   hsa_isa_t ISA, const char *VendorCompilerOptions);
+
+  // Queues the program for finalization in the finalizer threads and
+  // returns immediately. Done is called in a finalizer thread with the
+  // result. The program must not be destroyed before that.
+  void finalizeProgramAsync(hsa_ext_program_t Program,
+                            hsa_ext_control_directives_t ControlDirectives,
+                            hsa_isa_t ISA, std::string VendorCompilerOptions,
+                            FinalizeCallback Done);
+
+  // Finishes the queued finalizations.
+  virtual void shutDown();
+
+  // Sets the number of programs finalized concurrently. Zero means the
+  // number of hardware threads. Defaults to PHSA_FINALIZER_THREADS.
+  void setThreadCount(unsigned Count);
+
+private:
+  // Returns the pool, creating it on first use. Called with ThreadsLock
+  // held.
+  const std::shared_ptr<phsa::ThreadPool> &currentThreads();
+
+  // Returns true in case the calling thread belongs to the current or a
+  // retired pool.
+  bool isFinalizerThread();
+
+  // Replaced when the thread count changes. The batches in flight keep
+  // using the pool they started with.
+  std::shared_ptr<phsa::ThreadPool> Threads;
+  // The replaced pools not yet released because the replacing call came
+  // from one of their threads.
+  std::vector<std::shared_ptr<phsa::ThreadPool>> RetiredThreads;
+  std::mutex ThreadsLock;
 };
 
 #endif // HSA_RUNTIME_FINALIZER_HH
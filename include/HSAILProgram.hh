@@ -58,13 +58,8 @@ public:
     return DefaultRoundingMode;
   }
 
-  void addTempFile(std::string TempFile) { TempFiles.push_back(TempFile); }
-
-  bool dumpBRIGS(std::string TempDir, std::vector<std::string> &Paths);
-
 protected:
   std::vector<hsa_ext_module_t> BRIGs;
-  std::vector<std::string> TempFiles;
 
   hsa_machine_model_t MachineModel;
   hsa_profile_t Profile;
@@ -88,6 +88,21 @@ public:
     return nullptr;
   }
 
+  // Maps Count HSA objects at once. Returns false if any of them is
+  // unknown.
+  static bool fromHSAObjects(std::size_t Count, const HSAType *HSAObjects,
+                             ObjectType **Objects) {
+    std::lock_guard<std::recursive_mutex> Lock(RegistryLock);
+
+    for (std::size_t I = 0; I < Count; ++I) {
+      auto It = Registry.find(HSAObjects[I].handle);
+      if (It == Registry.end())
+        return false;
+      Objects[I] = It->second;
+    }
+    return true;
+  }
+
   // Map from PHSA object type to its HSA opaque struct counter part
   HSAType toHSAObject() const {
     return ObjectMapper(static_cast<const ObjectType *>(this));
@@ -0,0 +1,37 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The image extension.
+ */
+
+#ifndef HSA_RUNTIME_IMAGEEXTENSION_HH
+#define HSA_RUNTIME_IMAGEEXTENSION_HH
+
+#include "Extension.hh"
+
+// Exposes the hsa_ext_image_* and hsa_ext_sampler_* functions of
+// `hsa_image.cc` as the HSA_EXTENSION_IMAGES function table.
+class ImageExtension : public Extension {
+public:
+  virtual Identifier getIdentifier() const;
+  virtual Version getVersion() const { return {.Major = 1, .Minor = 0}; };
+  virtual void fillExtensionTable(void *table) const;
+};
+
+#endif // HSA_RUNTIME_IMAGEEXTENSION_HH
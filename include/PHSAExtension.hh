@@ -0,0 +1,39 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The phsa-runtime vendor extension.
+ */
+
+#ifndef HSA_RUNTIME_PHSAEXTENSION_HH
+#define HSA_RUNTIME_PHSAEXTENSION_HH
+
+#include "Extension.hh"
+
+// Exposes the hsa_ext_phsa_* functions as the HSA_EXTENSION_PHSA function
+// table. The functions themselves are implemented with the finalizer
+// extension in `hsa_finalize.cc` and with the image extension in
+// `hsa_image.cc`.
+class PHSAExtension : public Extension {
+public:
+  virtual Identifier getIdentifier() const;
+  virtual Version getVersion() const { return {.Major = 1, .Minor = 0}; };
+  virtual void fillExtensionTable(void *table) const;
+};
+
+#endif // HSA_RUNTIME_PHSAEXTENSION_HH
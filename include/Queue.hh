@@ -29,6 +29,7 @@
 #include <cinttypes>
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 #include <boost/thread/shared_mutex.hpp>
 
 #include "common/Atomic.hh"
@@ -51,6 +52,7 @@ public:
 
   Queue(hsa_queue_t *Queue, Agent *Owner = nullptr)
     : Owner(Owner), Destroyed(false), Inactivated(false),
+      ProfilingEnabled(false),
       LastHandledDoorBell(std::numeric_limits<hsa_signal_value_t>::max()) {
     registerQueue(this, Queue);
   }
@@ -78,6 +80,20 @@ public:
   void setInactivated();
   bool isInactivated() const { return Inactivated; }
 
+  // Whether the dispatch timestamps are recorded to the completion signals.
+  void setProfilingEnabled(bool Enable) { ProfilingEnabled = Enable; }
+  bool isProfilingEnabled() const { return ProfilingEnabled; }
+
+  // Restricts the dispatches of the queue to the compute units of which
+  // bits are set in Mask. An empty mask lifts the restriction. Every
+  // update gets a new process wide unique version, 0 standing for the
+  // unrestricted queue, so the agents can cheaply tell whether the mask
+  // they applied last is still valid.
+  void setComputeUnitMask(std::vector<uint32_t> Mask);
+  uint64_t getComputeUnitMaskVersion() const { return CUMaskVersion; }
+  // Copies the mask to Mask and returns its version.
+  uint64_t getComputeUnitMask(std::vector<uint32_t> &Mask) const;
+
   static void garbageCollect();
 
   virtual hsa_queue_t *getHSAQueue() {
@@ -117,11 +133,16 @@ private:
   }
 
   static std::atomic<uint64_t> QueueCount;
+  static std::atomic<uint64_t> LastCUMaskVersion;
   Agent *Owner;
   bool Destroyed;
   bool Inactivated;
+  bool ProfilingEnabled;
   std::vector<bool> PacketIsProcessed;
   hsa_signal_value_t LastHandledDoorBell;
+  std::vector<uint32_t> CUMask;
+  std::atomic<uint64_t> CUMaskVersion{0};
+  mutable std::mutex CUMaskLock;
 
 protected:
   phsa_queue HSAQueue;
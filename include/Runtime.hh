@@ -23,11 +23,14 @@
 #ifndef HSA_RUNTIME_RUNTIME_HH
 #define HSA_RUNTIME_RUNTIME_HH
 
+#include <atomic>
 #include <cinttypes>
 #include <mutex>
 #include <list>
+#include <vector>
 #include "hsa.h"
 
+#include "AsyncEvents.hh"
 #include "HSAReturnValue.hh"
 #include "ExtensionRegistry.hh"
 
@@ -55,6 +58,8 @@ public:
 
   ExtensionRegistry &getExtensionRegistry();
 
+  AsyncEvents &getAsyncEvents() { return Events; }
+
   void registerAgent(Agent *A);
   virtual void registerMemoryRegion(MemoryRegion *M) {
     MemoryRegions.push_back(M);
@@ -83,7 +88,33 @@ public:
   // given size by the executing core.
   virtual void flush(void *address, size_t size);
 
+  // Copies Size bytes from Src to Dst. The ranges may overlap.
+  virtual void copyMemory(void *Dst, const void *Src, size_t Size);
+
+  // Copies Size bytes from Src to Dst once all the Dependencies have
+  // reached zero, and decrements Completion (if given) by one when done.
+  // The default implementation waits and copies in the calling thread.
+  virtual void copyMemoryAsync(void *Dst, const void *Src, size_t Size,
+                               std::vector<Signal *> Dependencies,
+                               Signal *Completion);
+
+  // Whether copyMemoryAsync() records the start and end timestamps of the
+  // copies to their completion signals.
+  void setAsyncCopyProfiling(bool Enable) { AsyncCopyProfiling = Enable; }
+  bool isAsyncCopyProfiling() const { return AsyncCopyProfiling; }
+
+  // Registers a host buffer for use by the agents. In case Pin is true,
+  // the buffer should be kept resident in memory until it is
+  // deregistered. The default implementation does nothing.
+  virtual hsa_status_t registerMemory(void *Ptr, size_t Size, bool Pin);
+  virtual hsa_status_t deregisterMemory(void *Ptr);
+
 protected:
+  // Stops the asynchronous event handlers, the extensions and the agents.
+  // Subclasses call it from their destructors before their own services
+  // go away, as those might still be used by the stopped threads.
+  void shutDown();
+
   static int32_t ReferenceCounter;
   static std::mutex ReferenceCounterMutex;
   static Runtime *Instance;
@@ -91,6 +122,9 @@ protected:
   std::list<Agent *> Agents;
   ExtensionRegistry ER;
   std::list<MemoryRegion *> MemoryRegions;
+  AsyncEvents Events;
+  std::atomic<bool> AsyncCopyProfiling{false};
+  bool IsShutDown = false;
 };
 
 } // namespace phsa
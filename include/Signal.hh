@@ -25,6 +25,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <common/MemoryOrder.hh>
 
@@ -67,6 +69,60 @@ public:
   virtual hsa_signal_value_t compareExchange(hsa_signal_value_t Expected,
                                              hsa_signal_value_t Value,
                                              MemoryOrder MO) = 0;
+
+  // Returns the location of the value if it can be read with plain loads,
+  // otherwise nullptr and the value is read with load().
+  virtual const volatile hsa_signal_value_t *valueAddress() const {
+    return nullptr;
+  }
+
+  // The start and end timestamps of the dispatch or the copy that last
+  // completed the signal. Recorded only while profiling is enabled.
+  void setProfilingTimes(uint64_t Start, uint64_t End) {
+    ProfilingStart = Start;
+    ProfilingEnd = End;
+  }
+  uint64_t profilingStart() const { return ProfilingStart; }
+  uint64_t profilingEnd() const { return ProfilingEnd; }
+
+  static const uint32_t NoSignal = UINT32_MAX;
+
+  // Waits until any of the Count signals satisfies its condition and
+  // returns its index, or NoSignal if Timeout passes first. The values are
+  // read with relaxed semantics. Large sets of signals and Blocked waits
+  // sleep on SignalEvents between the checks instead of spinning.
+  static uint32_t waitAny(uint32_t Count, Signal *const *Signals,
+                          const hsa_signal_condition_t *Conditions,
+                          const hsa_signal_value_t *Values,
+                          std::chrono::high_resolution_clock::duration Timeout,
+                          bool Blocked, hsa_signal_value_t *SatisfyingValue);
+
+private:
+  uint64_t ProfilingStart = 0;
+  uint64_t ProfilingEnd = 0;
+};
+
+// Lets threads sleep until a signal value changes instead of polling the
+// signals. The signal implementations call notify() after changing a
+// value, which costs a fence and a load unless a thread is sleeping.
+//
+// A sleeper calls prepareSleep(), checks its signals and then either calls
+// sleep() with the returned change count or cancelSleep(). Values changed
+// outside of the runtime, for example by kernels, are not notified, so
+// sleepers should use a bounded timeout.
+class SignalEvents {
+public:
+  static void notify();
+
+  static uint64_t prepareSleep();
+  static void sleep(uint64_t ChangeCount, std::chrono::nanoseconds Timeout);
+  static void cancelSleep();
+
+private:
+  static std::atomic<uint64_t> Changes;
+  static std::atomic<uint32_t> Sleepers;
+  static std::mutex SleepLock;
+  static std::condition_variable Changed;
 };
 
 } // namespace phsa
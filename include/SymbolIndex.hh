@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Symbol lookup by canonical HSA symbol names.
+ */
+
+#ifndef HSA_RUNTIME_SYMBOLINDEX_HH
+#define HSA_RUNTIME_SYMBOLINDEX_HH
+
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace phsa {
+
+struct Symbol;
+
+// Indexes symbols by their canonical names. A program scope symbol is
+// named "&name" and a module scope one "&gccbrig.module.name", which is
+// the form GCC emits them in. The lookups accept the name with or
+// without the leading '&' and with the module given separately or as
+// "module::name". They do not allocate memory, except for names longer
+// than InlineNameLength.
+class SymbolIndex {
+public:
+  // Replaces a symbol of the same name, if any.
+  void insert(Symbol *S);
+
+  Symbol *find(boost::string_ref Name,
+               boost::string_ref ModuleName = boost::string_ref()) const;
+
+  std::size_t size() const { return Symbols.size(); }
+
+  static const std::size_t InlineNameLength = 256;
+
+  // The canonical form of a symbol name, built on the stack.
+  class CanonicalName {
+  public:
+    CanonicalName(boost::string_ref Name, boost::string_ref ModuleName);
+
+    boost::string_ref str() const {
+      return Overflow.empty() ? boost::string_ref(Inline, Length)
+                              : boost::string_ref(Overflow);
+    }
+    uint64_t hash() const { return Hash; }
+
+  private:
+    void append(char C);
+    void append(boost::string_ref S);
+
+    char Inline[InlineNameLength];
+    std::size_t Length = 0;
+    std::string Overflow;
+    uint64_t Hash;
+  };
+
+private:
+  struct Entry {
+    std::string Name;
+    Symbol *S;
+  };
+
+  // Keyed by the hash of the name so that the lookups need no key
+  // object.
+  std::unordered_multimap<uint64_t, Entry> Symbols;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_SYMBOLINDEX_HH
@@ -0,0 +1,253 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Vendor extensions of phsa-runtime.
+ */
+
+#ifndef HSA_RUNTIME_EXT_PHSA_H_
+#define HSA_RUNTIME_EXT_PHSA_H_
+
+#include "hsa.h"
+#include "hsa_ext_finalize.h"
+#include "hsa_ext_image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Identifier of the phsa-runtime vendor extension. The function
+ * table ::hsa_ext_phsa_1_00_pfn_t can be queried with
+ * ::hsa_system_get_extension_table using version 1.0.
+ */
+#define HSA_EXTENSION_PHSA 64
+
+/**
+ * @brief Finalizes a batch of programs concurrently in the finalizer
+ * threads. Returns once all of the programs have been finalized.
+ *
+ * @param[in] program_count Number of programs in @p programs.
+ *
+ * @param[in] programs The programs to finalize. The other parameters are
+ * the same as in ::hsa_ext_program_finalize and apply to all of them.
+ *
+ * @param[out] code_objects Memory location of @p program_count code
+ * objects, where the code object of each program is stored.
+ *
+ * @param[out] statuses Memory location of @p program_count statuses, where
+ * the result of finalizing each program is stored. Can be NULL.
+ *
+ * @retval ::HSA_STATUS_SUCCESS All the programs were finalized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p programs or
+ * @p code_objects is NULL.
+ *
+ * @retval Otherwise the status of the first program that failed.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_program_finalize_batch(
+    uint32_t program_count, const hsa_ext_program_t *programs, hsa_isa_t isa,
+    int32_t call_convention, hsa_ext_control_directives_t control_directives,
+    const char *options, hsa_code_object_type_t code_object_type,
+    hsa_code_object_t *code_objects, hsa_status_t *statuses);
+
+/**
+ * @brief Sets the number of programs finalized concurrently by
+ * ::hsa_ext_phsa_program_finalize_batch and
+ * ::hsa_ext_phsa_program_finalize_async. Zero selects the number of
+ * hardware threads. The default is read from the PHSA_FINALIZER_THREADS
+ * environment variable.
+ */
+hsa_status_t HSA_API
+hsa_ext_phsa_set_finalizer_thread_count(uint32_t thread_count);
+
+/**
+ * @brief Starts finalizing a program in the finalizer threads and returns
+ * without waiting for it to finish.
+ *
+ * @details Once the finalization has finished, the code object and the
+ * status are stored, and the value of @p completion_signal is decremented
+ * by one with release semantics. The program must not be destroyed or
+ * modified before that. The options are copied and need not outlive the
+ * call.
+ *
+ * @param[in] program The program to finalize. The other parameters up to
+ * @p code_object_type are the same as in ::hsa_ext_program_finalize.
+ *
+ * @param[out] code_object Memory location where the code object is stored.
+ * Must remain valid until @p completion_signal has been decremented.
+ *
+ * @param[out] status Memory location where the result of the finalization
+ * is stored. Can be NULL. Must remain valid until @p completion_signal has
+ * been decremented.
+ *
+ * @param[in] completion_signal Signal decremented when the code object is
+ * ready or the finalization failed.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The finalization was started.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p code_object is NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL @p completion_signal is invalid.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_program_finalize_async(
+    hsa_ext_program_t program, hsa_isa_t isa, int32_t call_convention,
+    hsa_ext_control_directives_t control_directives, const char *options,
+    hsa_code_object_type_t code_object_type, hsa_code_object_t *code_object,
+    hsa_status_t *status, hsa_signal_t completion_signal);
+
+/**
+ * @brief Writes the code objects finalized from the programs to a code
+ * bundle file, from which they can be loaded without finalizing.
+ *
+ * @param[in] path Path of the bundle file to create or replace.
+ *
+ * @param[in] count Number of entries in @p programs and @p code_objects.
+ *
+ * @param[in] programs The programs the code objects were finalized from.
+ * Identify the entries together with @p isa.
+ *
+ * @param[in] isa The ISA the code objects were finalized for.
+ *
+ * @param[in] code_objects The code objects to store.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The bundle was written.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p path, @p programs or
+ * @p code_objects is NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR The file could not be written.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_create(
+    const char *path, uint32_t count, const hsa_ext_program_t *programs,
+    hsa_isa_t isa, const hsa_code_object_t *code_objects);
+
+/**
+ * @brief Maps a code bundle file to memory. ::hsa_ext_program_finalize
+ * returns the code objects found in the loaded bundles instead of
+ * finalizing the programs. Bundles are also loaded from the colon
+ * separated list of files in the PHSA_CODE_BUNDLES environment variable.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The bundle was loaded.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_CODE_OBJECT The file could not be read or
+ * is not a code bundle.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_load(const char *path);
+
+/**
+ * @brief Finds the code object of a program in the loaded code bundles.
+ *
+ * @param[out] serialized_code_object Memory location where a pointer to
+ * the serialized code object is stored. It can be passed to
+ * ::hsa_code_object_deserialize, and stays valid until the process exits.
+ *
+ * @param[out] serialized_code_object_size Memory location where the size
+ * of the serialized code object is stored.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The code object was found.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_CODE_OBJECT None of the loaded
+ * bundles has a code object for the program.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_find(
+    hsa_ext_program_t program, hsa_isa_t isa,
+    const void **serialized_code_object, size_t *serialized_code_object_size);
+
+/**
+ * @brief Imports linear image data of another format to an image,
+ * converting the elements to the format of the image.
+ *
+ * @details Works like ::hsa_ext_image_import, except that the elements in
+ * @p src_memory are of @p src_format. The elements are converted through
+ * their access values, the same way an image of @p src_format is read
+ * and an image of the image format is written by a kernel. The pitches
+ * are in bytes, as in ::hsa_ext_image_import.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The image was imported.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p src_memory, @p src_format
+ * or @p image_region is NULL, or the image is invalid.
+ *
+ * @retval ::HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED @p src_format is
+ * not supported or its access type is not the one of the image format.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_image_import(
+    hsa_agent_t agent, const void *src_memory,
+    const hsa_ext_image_format_t *src_format, size_t src_row_pitch,
+    size_t src_slice_pitch, hsa_ext_image_t dst_image,
+    const hsa_ext_image_region_t *image_region);
+
+/**
+ * @brief Exports an image to linear memory of another format, converting
+ * the elements to @p dst_format. The counterpart of
+ * ::hsa_ext_phsa_image_import.
+ */
+hsa_status_t HSA_API hsa_ext_phsa_image_export(
+    hsa_agent_t agent, hsa_ext_image_t src_image, void *dst_memory,
+    const hsa_ext_image_format_t *dst_format, size_t dst_row_pitch,
+    size_t dst_slice_pitch, const hsa_ext_image_region_t *image_region);
+
+/**
+ * @brief Function table of the ::HSA_EXTENSION_PHSA extension.
+ */
+typedef struct hsa_ext_phsa_1_00_pfn_s {
+  hsa_status_t (*hsa_ext_phsa_program_finalize_batch)(
+      uint32_t program_count, const hsa_ext_program_t *programs,
+      hsa_isa_t isa, int32_t call_convention,
+      hsa_ext_control_directives_t control_directives, const char *options,
+      hsa_code_object_type_t code_object_type,
+      hsa_code_object_t *code_objects, hsa_status_t *statuses);
+
+  hsa_status_t (*hsa_ext_phsa_set_finalizer_thread_count)(
+      uint32_t thread_count);
+
+  hsa_status_t (*hsa_ext_phsa_program_finalize_async)(
+      hsa_ext_program_t program, hsa_isa_t isa, int32_t call_convention,
+      hsa_ext_control_directives_t control_directives, const char *options,
+      hsa_code_object_type_t code_object_type,
+      hsa_code_object_t *code_object, hsa_status_t *status,
+      hsa_signal_t completion_signal);
+  hsa_status_t (*hsa_ext_phsa_code_bundle_create)(
+      const char *path, uint32_t count, const hsa_ext_program_t *programs,
+      hsa_isa_t isa, const hsa_code_object_t *code_objects);
+
+  hsa_status_t (*hsa_ext_phsa_code_bundle_load)(const char *path);
+
+  hsa_status_t (*hsa_ext_phsa_code_bundle_find)(
+      hsa_ext_program_t program, hsa_isa_t isa,
+      const void **serialized_code_object,
+      size_t *serialized_code_object_size);
+
+  hsa_status_t (*hsa_ext_phsa_image_import)(
+      hsa_agent_t agent, const void *src_memory,
+      const hsa_ext_image_format_t *src_format, size_t src_row_pitch,
+      size_t src_slice_pitch, hsa_ext_image_t dst_image,
+      const hsa_ext_image_region_t *image_region);
+
+  hsa_status_t (*hsa_ext_phsa_image_export)(
+      hsa_agent_t agent, hsa_ext_image_t src_image, void *dst_memory,
+      const hsa_ext_image_format_t *dst_format, size_t dst_row_pitch,
+      size_t dst_slice_pitch, const hsa_ext_image_region_t *image_region);
+} hsa_ext_phsa_1_00_pfn_t;
+
+#ifdef __cplusplus
+}  // end extern "C" block
+#endif
+
+#endif // HSA_RUNTIME_EXT_PHSA_H_
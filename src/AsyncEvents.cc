@@ -0,0 +1,153 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Asynchronous signal handlers and functions of the AMD extension.
+ */
+
+#include "AsyncEvents.hh"
+
+#include "Signal.hh"
+
+namespace phsa {
+
+namespace {
+
+// How long the event thread sleeps before checking the handler signals
+// again in case none of the changes were notified.
+const std::chrono::milliseconds HandlerPollInterval(1);
+
+bool holds(hsa_signal_condition_t Condition, hsa_signal_value_t Value,
+           hsa_signal_value_t CompareValue) {
+  switch (Condition) {
+  case HSA_SIGNAL_CONDITION_EQ:
+    return Value == CompareValue;
+  case HSA_SIGNAL_CONDITION_NE:
+    return Value != CompareValue;
+  case HSA_SIGNAL_CONDITION_LT:
+    return Value < CompareValue;
+  case HSA_SIGNAL_CONDITION_GTE:
+    return Value >= CompareValue;
+  }
+  return false;
+}
+
+} // namespace
+
+AsyncEvents::~AsyncEvents() { shutDown(); }
+
+void AsyncEvents::addHandler(Signal &S, hsa_signal_condition_t Condition,
+                             hsa_signal_value_t Value, Handler H, void *Arg) {
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    NewHandlers.push_back(SignalHandler{&S, Condition, Value, H, Arg});
+    start();
+  }
+  Wakeup.notify_one();
+  SignalEvents::notify();
+}
+
+void AsyncEvents::addFunction(Function F, void *Arg) {
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    Functions.push_back(QueuedFunction{F, Arg});
+    start();
+  }
+  Wakeup.notify_one();
+  SignalEvents::notify();
+}
+
+void AsyncEvents::shutDown() {
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    ShuttingDown = true;
+  }
+  Wakeup.notify_one();
+  SignalEvents::notify();
+  if (EventThread.joinable())
+    EventThread.join();
+}
+
+// Called with Lock held.
+void AsyncEvents::start() {
+  if (!EventThread.joinable() && !ShuttingDown)
+    EventThread = std::thread(&AsyncEvents::run, this);
+}
+
+void AsyncEvents::run() {
+  std::vector<SignalHandler> Handlers;
+  std::vector<QueuedFunction> Queued;
+
+  while (true) {
+    // Registered before checking anything, so the notifications of the
+    // changes after the checks wake up the thread.
+    uint64_t ChangeCount = SignalEvents::prepareSleep();
+    {
+      std::lock_guard<std::mutex> L(Lock);
+      if (ShuttingDown) {
+        SignalEvents::cancelSleep();
+        return;
+      }
+      Handlers.insert(Handlers.end(), NewHandlers.begin(), NewHandlers.end());
+      NewHandlers.clear();
+      Queued.swap(Functions);
+    }
+
+    bool Progress = !Queued.empty();
+    for (const QueuedFunction &Q : Queued)
+      Q.F(Q.Arg);
+    Queued.clear();
+
+    for (std::size_t I = 0; I < Handlers.size();) {
+      SignalHandler &SH = Handlers[I];
+      hsa_signal_value_t Value = SH.S->load(MemoryOrder::Acquire);
+      if (!holds(SH.Condition, Value, SH.Value)) {
+        ++I;
+        continue;
+      }
+      Progress = true;
+      if (SH.H(Value, SH.Arg)) {
+        ++I;
+        continue;
+      }
+      // The order of the handlers does not matter.
+      Handlers[I] = Handlers.back();
+      Handlers.pop_back();
+    }
+
+    if (Progress) {
+      SignalEvents::cancelSleep();
+      continue;
+    }
+    if (!Handlers.empty()) {
+      SignalEvents::sleep(ChangeCount, HandlerPollInterval);
+      continue;
+    }
+
+    // Without handlers there are no signals to watch, so the thread waits
+    // for new registrations without being a SignalEvents sleeper, which
+    // would make every signal operation notify it.
+    SignalEvents::cancelSleep();
+    std::unique_lock<std::mutex> L(Lock);
+    Wakeup.wait(L, [this]() {
+      return ShuttingDown || !NewHandlers.empty() || !Functions.empty();
+    });
+  }
+}
+
+} // namespace phsa
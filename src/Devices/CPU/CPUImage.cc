@@ -0,0 +1,351 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Images and samplers of the CPU agents.
+ */
+
+#include "CPUImage.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ImageFormat.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace phsa {
+
+const uint32_t CPUImage::TileWidth;
+const uint32_t CPUImage::TileHeight;
+const std::size_t CPUImage::DataAlignment;
+const std::size_t CPUImage::Max1DWidth;
+const std::size_t CPUImage::Max1DBWidth;
+const std::size_t CPUImage::Max2DSize;
+const std::size_t CPUImage::Max3DSize;
+const std::size_t CPUImage::MaxLayers;
+const uint32_t CPUImage::MaxHandles;
+
+namespace {
+
+// The width, the number of rows and the number of slices of an image.
+struct Extent {
+  std::size_t Width;
+  std::size_t Rows;
+  std::size_t Slices;
+};
+
+Extent extentOf(const hsa_ext_image_descriptor_t &Descriptor) {
+  std::size_t Height = Descriptor.height;
+  std::size_t Layers = std::max<std::size_t>(Descriptor.array_size, 1);
+  switch (Descriptor.geometry) {
+  case HSA_EXT_IMAGE_GEOMETRY_1DA:
+    return {Descriptor.width, 1, Layers};
+  case HSA_EXT_IMAGE_GEOMETRY_2D:
+  case HSA_EXT_IMAGE_GEOMETRY_2DDEPTH:
+    return {Descriptor.width, Height, 1};
+  case HSA_EXT_IMAGE_GEOMETRY_2DA:
+  case HSA_EXT_IMAGE_GEOMETRY_2DADEPTH:
+    return {Descriptor.width, Height, Layers};
+  case HSA_EXT_IMAGE_GEOMETRY_3D:
+    return {Descriptor.width, Height,
+            std::max<std::size_t>(Descriptor.depth, 1)};
+  default:
+    return {Descriptor.width, 1, 1};
+  }
+}
+
+bool hasRows(hsa_ext_image_geometry_t Geometry) {
+  return Geometry != HSA_EXT_IMAGE_GEOMETRY_1D &&
+         Geometry != HSA_EXT_IMAGE_GEOMETRY_1DA &&
+         Geometry != HSA_EXT_IMAGE_GEOMETRY_1DB;
+}
+
+bool isSupportedExtent(hsa_ext_image_geometry_t Geometry, const Extent &E) {
+  if (E.Width == 0 || E.Rows == 0)
+    return false;
+  switch (Geometry) {
+  case HSA_EXT_IMAGE_GEOMETRY_1D:
+  case HSA_EXT_IMAGE_GEOMETRY_1DA:
+    return E.Width <= CPUImage::Max1DWidth && E.Slices <= CPUImage::MaxLayers;
+  case HSA_EXT_IMAGE_GEOMETRY_1DB:
+    return E.Width <= CPUImage::Max1DBWidth;
+  case HSA_EXT_IMAGE_GEOMETRY_3D:
+    return E.Width <= CPUImage::Max3DSize && E.Rows <= CPUImage::Max3DSize &&
+           E.Slices <= CPUImage::Max3DSize;
+  default:
+    return E.Width <= CPUImage::Max2DSize && E.Rows <= CPUImage::Max2DSize &&
+           E.Slices <= CPUImage::MaxLayers;
+  }
+}
+
+// The extent of the image coordinates, where the layers of 1D arrays are
+// along Y and the layers of 2D arrays along Z.
+hsa_dim3_t coordinateExtent(const hsa_ext_image_descriptor_t &Descriptor) {
+  Extent E = extentOf(Descriptor);
+  if (Descriptor.geometry == HSA_EXT_IMAGE_GEOMETRY_1DA)
+    return {static_cast<uint32_t>(E.Width), static_cast<uint32_t>(E.Slices),
+            1};
+  return {static_cast<uint32_t>(E.Width), static_cast<uint32_t>(E.Rows),
+          static_cast<uint32_t>(E.Slices)};
+}
+
+// Regions with a height or a depth of 0 have a single row or slice.
+hsa_dim3_t regionRange(const hsa_dim3_t &Range) {
+  return {Range.x, std::max(Range.y, 1u), std::max(Range.z, 1u)};
+}
+
+bool sameFormat(const hsa_ext_image_format_t &A,
+                const hsa_ext_image_format_t &B) {
+  return A.channel_type == B.channel_type &&
+         A.channel_order == B.channel_order;
+}
+
+// The tile rows are at most 128 bytes long, so the copies and fills are
+// done with unaligned vector moves rather than calling memcpy per run.
+void copyElements(uint8_t *Dst, const uint8_t *Src, std::size_t Size) {
+#ifdef __SSE2__
+  for (; Size >= 16; Size -= 16, Dst += 16, Src += 16)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(Dst),
+                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(Src)));
+#endif
+  std::memcpy(Dst, Src, Size);
+}
+
+// Fills Size bytes at Dst with the 16 byte Pattern.
+void fillElements(uint8_t *Dst, const uint8_t *Pattern, std::size_t Size) {
+#ifdef __SSE2__
+  __m128i Value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Pattern));
+  for (; Size >= 16; Size -= 16, Dst += 16)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(Dst), Value);
+#else
+  for (; Size >= 16; Size -= 16, Dst += 16)
+    std::memcpy(Dst, Pattern, 16);
+#endif
+  std::memcpy(Dst, Pattern, Size);
+}
+
+} // namespace
+
+hsa_status_t CPUImage::dataInfo(const hsa_ext_image_descriptor_t &Descriptor,
+                                hsa_ext_image_data_info_t &Info) {
+  std::size_t ElementSize =
+      imageElementSize(Descriptor.geometry, Descriptor.format);
+  if (ElementSize == 0)
+    return (hsa_status_t)HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED;
+
+  Extent E = extentOf(Descriptor);
+  if (!isSupportedExtent(Descriptor.geometry, E))
+    return (hsa_status_t)HSA_EXT_STATUS_ERROR_IMAGE_SIZE_UNSUPPORTED;
+
+  uint32_t RowsPerTile = hasRows(Descriptor.geometry) ? TileHeight : 1;
+  std::size_t TilesPerRow = (E.Width + TileWidth - 1) / TileWidth;
+  std::size_t TileRows = (E.Rows + RowsPerTile - 1) / RowsPerTile;
+  Info.size =
+      TilesPerRow * TileRows * TileWidth * RowsPerTile * ElementSize * E.Slices;
+  Info.alignment = DataAlignment;
+  return HSA_STATUS_SUCCESS;
+}
+
+CPUImage::CPUImage(const hsa_ext_image_descriptor_t &Descriptor, void *Data)
+    : Descriptor(Descriptor), Data(static_cast<uint8_t *>(Data)),
+      ElementSize(imageElementSize(Descriptor.geometry, Descriptor.format)),
+      RowsPerTile(hasRows(Descriptor.geometry) ? TileHeight : 1) {
+  Extent E = extentOf(Descriptor);
+  TilesPerRow = (E.Width + TileWidth - 1) / TileWidth;
+  TileSize = TileWidth * RowsPerTile * ElementSize;
+  SliceSize = TilesPerRow * ((E.Rows + RowsPerTile - 1) / RowsPerTile) *
+              TileSize;
+}
+
+uint8_t *CPUImage::address(uint32_t X, uint32_t Y, uint32_t Z) const {
+  std::size_t Row = 0, Slice = 0;
+  switch (Descriptor.geometry) {
+  case HSA_EXT_IMAGE_GEOMETRY_1DA:
+    Slice = Y;
+    break;
+  case HSA_EXT_IMAGE_GEOMETRY_2D:
+  case HSA_EXT_IMAGE_GEOMETRY_2DDEPTH:
+    Row = Y;
+    break;
+  case HSA_EXT_IMAGE_GEOMETRY_2DA:
+  case HSA_EXT_IMAGE_GEOMETRY_2DADEPTH:
+  case HSA_EXT_IMAGE_GEOMETRY_3D:
+    Row = Y;
+    Slice = Z;
+    break;
+  default:
+    break;
+  }
+  std::size_t Tile = (Row / RowsPerTile) * TilesPerRow + X / TileWidth;
+  std::size_t Element = (Row % RowsPerTile) * TileWidth + X % TileWidth;
+  return Data + Slice * SliceSize + Tile * TileSize + Element * ElementSize;
+}
+
+bool CPUImage::contains(const hsa_dim3_t &Offset,
+                        const hsa_dim3_t &Range) const {
+  hsa_dim3_t Size = regionRange(Range);
+  hsa_dim3_t Limit = coordinateExtent(Descriptor);
+  return uint64_t(Offset.x) + Size.x <= Limit.x &&
+         uint64_t(Offset.y) + Size.y <= Limit.y &&
+         uint64_t(Offset.z) + Size.z <= Limit.z;
+}
+
+template <typename Function>
+void CPUImage::forEachRun(const hsa_dim3_t &Offset, const hsa_dim3_t &Range,
+                          Function F) const {
+  for (uint32_t Z = 0; Z < Range.z; ++Z) {
+    for (uint32_t Y = 0; Y < Range.y; ++Y) {
+      uint32_t X = Offset.x, End = Offset.x + Range.x;
+      while (X < End) {
+        uint32_t N = std::min(TileWidth - X % TileWidth, End - X);
+        F(address(X, Offset.y + Y, Offset.z + Z), Y, Z, N);
+        X += N;
+      }
+    }
+  }
+}
+
+hsa_status_t CPUImage::import(const void *Src,
+                              const hsa_ext_image_format_t &Format,
+                              std::size_t RowPitch, std::size_t SlicePitch,
+                              const hsa_ext_image_region_t &Region) {
+  if (!contains(Region.offset, Region.range))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  bool Convert = !sameFormat(Format, Descriptor.format);
+  std::size_t LinearSize = imageElementSize(Format);
+  hsa_dim3_t Range = regionRange(Region.range);
+  RowPitch = std::max(RowPitch, Range.x * LinearSize);
+  SlicePitch = std::max(SlicePitch, RowPitch * Range.y);
+
+  const uint8_t *Memory = static_cast<const uint8_t *>(Src);
+  const uint8_t *Row = nullptr;
+  uint32_t LastY = ~0u, LastZ = ~0u;
+  forEachRun(Region.offset, Range,
+             [&](uint8_t *Element, uint32_t Y, uint32_t Z, uint32_t N) {
+               if (Y != LastY || Z != LastZ) {
+                 Row = Memory + Z * SlicePitch + Y * RowPitch;
+                 LastY = Y;
+                 LastZ = Z;
+               }
+               if (Convert)
+                 convertImageElements(Descriptor.format, Element, Format, Row,
+                                      N);
+               else
+                 copyElements(Element, Row, N * ElementSize);
+               Row += N * LinearSize;
+             });
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t CPUImage::exportTo(void *Dst,
+                                const hsa_ext_image_format_t &Format,
+                                std::size_t RowPitch, std::size_t SlicePitch,
+                                const hsa_ext_image_region_t &Region) const {
+  if (!contains(Region.offset, Region.range))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  bool Convert = !sameFormat(Format, Descriptor.format);
+  std::size_t LinearSize = imageElementSize(Format);
+  hsa_dim3_t Range = regionRange(Region.range);
+  RowPitch = std::max(RowPitch, Range.x * LinearSize);
+  SlicePitch = std::max(SlicePitch, RowPitch * Range.y);
+
+  uint8_t *Memory = static_cast<uint8_t *>(Dst);
+  uint8_t *Row = nullptr;
+  uint32_t LastY = ~0u, LastZ = ~0u;
+  forEachRun(Region.offset, Range,
+             [&](const uint8_t *Element, uint32_t Y, uint32_t Z, uint32_t N) {
+               if (Y != LastY || Z != LastZ) {
+                 Row = Memory + Z * SlicePitch + Y * RowPitch;
+                 LastY = Y;
+                 LastZ = Z;
+               }
+               if (Convert)
+                 convertImageElements(Format, Row, Descriptor.format, Element,
+                                      N);
+               else
+                 copyElements(Row, Element, N * ElementSize);
+               Row += N * LinearSize;
+             });
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t CPUImage::copyFrom(const CPUImage &Src,
+                                const hsa_dim3_t &SrcOffset,
+                                const hsa_dim3_t &DstOffset,
+                                const hsa_dim3_t &Range) {
+  if (!Src.contains(SrcOffset, Range) || !contains(DstOffset, Range))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  hsa_dim3_t Size = regionRange(Range);
+  for (uint32_t Z = 0; Z < Size.z; ++Z) {
+    for (uint32_t Y = 0; Y < Size.y; ++Y) {
+      for (uint32_t X = 0; X < Size.x;) {
+        uint32_t SrcX = SrcOffset.x + X, DstX = DstOffset.x + X;
+        // The runs end at the tile row ends of both of the images.
+        uint32_t N = std::min(std::min(TileWidth - SrcX % TileWidth,
+                                       TileWidth - DstX % TileWidth),
+                              Size.x - X);
+        copyElements(address(DstX, DstOffset.y + Y, DstOffset.z + Z),
+                     Src.address(SrcX, SrcOffset.y + Y, SrcOffset.z + Z),
+                     N * ElementSize);
+        X += N;
+      }
+    }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t CPUImage::clear(const void *Value,
+                             const hsa_ext_image_region_t &Region) {
+  if (!contains(Region.offset, Region.range))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  uint8_t Element[16];
+  encodeImageElement(Descriptor.format, Value, Element);
+
+  // The element sizes are powers of two so the pattern starts at each
+  // element.
+  uint8_t Pattern[16];
+  for (std::size_t I = 0; I < sizeof(Pattern); I += ElementSize)
+    std::memcpy(Pattern + I, Element, ElementSize);
+
+  forEachRun(Region.offset, regionRange(Region.range),
+             [&](uint8_t *Dst, uint32_t, uint32_t, uint32_t N) {
+               fillElements(Dst, Pattern, N * ElementSize);
+             });
+  return HSA_STATUS_SUCCESS;
+}
+
+bool CPUSampler::isValid(const hsa_ext_sampler_descriptor_t &Descriptor) {
+  if (Descriptor.coordinate_mode > HSA_EXT_SAMPLER_COORDINATE_MODE_NORMALIZED ||
+      Descriptor.filter_mode > HSA_EXT_SAMPLER_FILTER_MODE_LINEAR ||
+      Descriptor.address_mode > HSA_EXT_SAMPLER_ADDRESSING_MODE_MIRRORED_REPEAT)
+    return false;
+
+  // Repeating is only defined for normalized coordinates.
+  return Descriptor.coordinate_mode ==
+             HSA_EXT_SAMPLER_COORDINATE_MODE_NORMALIZED ||
+         Descriptor.address_mode < HSA_EXT_SAMPLER_ADDRESSING_MODE_REPEAT;
+}
+
+} // namespace phsa
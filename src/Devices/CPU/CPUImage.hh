@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Images and samplers of the CPU agents.
+ */
+
+#ifndef HSA_RUNTIME_CPUIMAGE_HH
+#define HSA_RUNTIME_CPUIMAGE_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hsa_ext_image.h"
+#include "HSAObjectMapping.hh"
+
+namespace phsa {
+
+// An image stored in the caller allocated image data. The elements are
+// stored in tiles of TileWidth x TileHeight elements so the elements of a
+// 2D neighborhood share cache lines and pages, and a tile row is a run of
+// contiguous elements. The tiles of a slice are stored in row major order,
+// and the slices of 3D images and the layers of image arrays follow each
+// other. Images without rows use tiles of a single row.
+class CPUImage : public HSAObjectMapping<CPUImage, hsa_ext_image_t> {
+public:
+  static const uint32_t TileWidth = 8;
+  static const uint32_t TileHeight = 8;
+  static const std::size_t DataAlignment = 64;
+
+  // The largest supported image dimensions, reported in the
+  // HSA_EXT_AGENT_INFO_IMAGE_* agent attributes.
+  static const std::size_t Max1DWidth = 16384;
+  static const std::size_t Max1DBWidth = 65536;
+  static const std::size_t Max2DSize = 16384;
+  static const std::size_t Max3DSize = 2048;
+  static const std::size_t MaxLayers = 2048;
+
+  // Images and samplers are only limited by the host memory.
+  static const uint32_t MaxHandles = 65536;
+
+  // Returns the size and the alignment of the image data of Descriptor in
+  // Info, or HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED or
+  // HSA_EXT_STATUS_ERROR_IMAGE_SIZE_UNSUPPORTED.
+  static hsa_status_t dataInfo(const hsa_ext_image_descriptor_t &Descriptor,
+                               hsa_ext_image_data_info_t &Info);
+
+  // Descriptor must have passed dataInfo.
+  CPUImage(const hsa_ext_image_descriptor_t &Descriptor, void *Data);
+
+  const hsa_ext_image_descriptor_t &descriptor() const { return Descriptor; }
+  std::size_t elementSize() const { return ElementSize; }
+
+  // Returns true in case the Range elements at Offset are within the
+  // image. A Range height or depth of 0 means a single row or slice.
+  bool contains(const hsa_dim3_t &Offset, const hsa_dim3_t &Range) const;
+
+  // Copies the elements of Region from/to linear memory with the given
+  // pitches. Pitches smaller than the packed rows or slices of the region
+  // are raised to them, so 0 means tightly packed. The elements in the
+  // linear memory are of Format, and are converted unless it is the format
+  // of the image. The format must be convertible, see
+  // canConvertImageElements. Returns HSA_STATUS_ERROR_INVALID_ARGUMENT in
+  // case the region is not within the image.
+  hsa_status_t import(const void *Src, const hsa_ext_image_format_t &Format,
+                      std::size_t RowPitch, std::size_t SlicePitch,
+                      const hsa_ext_image_region_t &Region);
+  hsa_status_t exportTo(void *Dst, const hsa_ext_image_format_t &Format,
+                        std::size_t RowPitch, std::size_t SlicePitch,
+                        const hsa_ext_image_region_t &Region) const;
+
+  // Copies Range elements from SrcOffset of Src to DstOffset. The images
+  // must have the same element size. Returns
+  // HSA_STATUS_ERROR_INVALID_ARGUMENT in case the region is not within
+  // both of the images.
+  hsa_status_t copyFrom(const CPUImage &Src, const hsa_dim3_t &SrcOffset,
+                        const hsa_dim3_t &DstOffset, const hsa_dim3_t &Range);
+
+  // Fills Region with the clear value Value, see encodeImageElement.
+  hsa_status_t clear(const void *Value, const hsa_ext_image_region_t &Region);
+
+private:
+  // Returns the address of the element at X in the row and slice the
+  // image coordinates Y and Z map to.
+  uint8_t *address(uint32_t X, uint32_t Y, uint32_t Z) const;
+
+  // Calls F(Element, Y, Z, N) for each run of N elements of the region
+  // that is contiguous in the image. Y and Z are relative to Offset, and
+  // the runs of a row are visited in order.
+  template <typename Function>
+  void forEachRun(const hsa_dim3_t &Offset, const hsa_dim3_t &Range,
+                  Function F) const;
+
+  hsa_ext_image_descriptor_t Descriptor;
+  uint8_t *Data;
+  std::size_t ElementSize;
+  uint32_t RowsPerTile;
+  std::size_t TilesPerRow;
+  std::size_t TileSize;
+  std::size_t SliceSize;
+};
+
+class CPUSampler : public HSAObjectMapping<CPUSampler, hsa_ext_sampler_t> {
+public:
+  CPUSampler(const hsa_ext_sampler_descriptor_t &Descriptor)
+      : Descriptor(Descriptor) {}
+
+  const hsa_ext_sampler_descriptor_t &descriptor() const { return Descriptor; }
+
+  static bool isValid(const hsa_ext_sampler_descriptor_t &Descriptor);
+
+private:
+  hsa_ext_sampler_descriptor_t Descriptor;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_CPUIMAGE_HH
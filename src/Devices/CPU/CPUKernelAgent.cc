@@ -29,7 +29,9 @@
 #include <phsa-rt.h>
 #include <setjmp.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <vector>
 
 #include "common/Logging.hh"
 #include "Executable.hh"
@@ -38,11 +40,35 @@
 #include "Finalizer/GCC/DLFinalizedProgram.hh"
 #include "Signal.hh"
 #include "MemoryRegion.hh"
+#include "common/Timestamp.hh"
 
 namespace phsa {
 
 std::atomic<bool> ShutDown(false);
 
+namespace {
+
+// The host cores the process was allowed to run on when the agent was
+// first used, in ascending order. Compute unit I maps to core
+// hostCores()[I].
+const std::vector<int> &hostCores() {
+  static const std::vector<int> Cores = []() {
+    std::vector<int> Cores;
+    cpu_set_t Allowed;
+    if (sched_getaffinity(0, sizeof(Allowed), &Allowed) == 0) {
+      for (int CPU = 0; CPU < CPU_SETSIZE; ++CPU)
+        if (CPU_ISSET(CPU, &Allowed))
+          Cores.push_back(CPU);
+    }
+    if (Cores.empty())
+      Cores.push_back(0);
+    return Cores;
+  }();
+  return Cores;
+}
+
+} // namespace
+
 CPUKernelAgent::CPUKernelAgent(MemoryRegion &QueueMemRegion)
     : Worker(&CPUKernelAgent::Execute, this), QueueRegion(QueueMemRegion),
       AgentISA("host-isa") {
@@ -65,6 +91,36 @@ void CPUKernelAgent::shutDown() {
 
 CPUKernelAgent::~CPUKernelAgent() {}
 
+uint32_t CPUKernelAgent::getComputeUnitCount() const {
+  return hostCores().size();
+}
+
+void CPUKernelAgent::applyComputeUnitMask(Queue &Q) {
+  if (Q.getComputeUnitMaskVersion() == AppliedCUMaskVersion)
+    return;
+
+  std::vector<uint32_t> Mask;
+  uint64_t Version = Q.getComputeUnitMask(Mask);
+  const std::vector<int> &Cores = hostCores();
+
+  cpu_set_t Allowed;
+  CPU_ZERO(&Allowed);
+  for (std::size_t CU = 0; CU < Cores.size(); ++CU) {
+    if (Mask.empty() ||
+        (CU / 32 < Mask.size() && (Mask[CU / 32] >> CU % 32 & 1) != 0))
+      CPU_SET(Cores[CU], &Allowed);
+  }
+  // A mask without any of the existing compute units does not restrict
+  // the queue rather than stalling it.
+  if (CPU_COUNT(&Allowed) == 0) {
+    for (int Core : Cores)
+      CPU_SET(Core, &Allowed);
+  }
+
+  pthread_setaffinity_np(pthread_self(), sizeof(Allowed), &Allowed);
+  AppliedCUMaskVersion = Version;
+}
+
 bool CPUKernelAgent::AreDimensionsvalid(
     hsa_kernel_dispatch_packet_t &KernelPacket) {
   int Dimensions = ((1 << (HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS +
@@ -165,6 +221,9 @@ void CPUKernelAgent::Execute() {
 
   RunningQueue = nullptr;
   InterruptingTheQueue = false;
+  // Makes the next dispatch apply its compute unit mask, also after an
+  // interruption which might have happened while changing the affinity.
+  AppliedCUMaskVersion = std::numeric_limits<uint64_t>::max();
 
   while (!ShutDown) {
 
@@ -260,6 +319,9 @@ void CPUKernelAgent::Execute() {
           continue;
         }
 
+        bool Profiling = Q->isProfilingEnabled();
+        uint64_t StartTime = Profiling ? Timestamp::now() : 0;
+
         if (PacketType == HSA_PACKET_TYPE_BARRIER_AND) {
 
           hsa_barrier_and_packet_t &BarrierAndPacket = Packet.BarrierAnd;
@@ -334,6 +396,8 @@ void CPUKernelAgent::Execute() {
             GCCBrigKernel KernelFunction =
                 reinterpret_cast<GCCBrigKernelSignature *>(K->Address);
 
+            applyComputeUnitMask(*Q);
+
             PHSAKernelLaunchData LaunchData;
             LaunchData.dp = &KernelPacket;
             LaunchData.packet_id = CurrentIndex;
@@ -391,6 +455,8 @@ void CPUKernelAgent::Execute() {
         }
 
         if (CompletionSignal != nullptr) {
+          if (Profiling)
+            CompletionSignal->setProfilingTimes(StartTime, Timestamp::now());
           CompletionSignal->store(0, MemoryOrder::Relaxed);
         }
       }
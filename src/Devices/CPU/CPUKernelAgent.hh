@@ -92,6 +92,9 @@ public:
     return {16 * 1024, 0, 0, 0};
   }
 
+  // Each host core the process may run on is a compute unit.
+  virtual uint32_t getComputeUnitCount() const override;
+
   virtual const std::string getISA() const override { return AgentISA; }
 
   virtual Version getVersion() const override { return {1, 0}; }
@@ -141,6 +144,8 @@ private:
 
   bool AreDimensionsvalid(hsa_kernel_dispatch_packet_t &KernelPacket);
   bool IsPacketTypeValid(uint16_t Header);
+  // Moves the executor to the cores of the compute unit mask of Q.
+  void applyComputeUnitMask(Queue &Q);
   void Execute();
   std::thread Worker;
   MemoryRegion &QueueRegion;
@@ -149,6 +154,8 @@ private:
   std::atomic<Queue *> RunningQueue;
   // Set to true in case the agent is being interrupted by the client program.
   std::atomic<bool> InterruptingTheQueue;
+  // The version of the compute unit mask the executor runs with.
+  uint64_t AppliedCUMaskVersion;
 };
 
 } // namespace phsa
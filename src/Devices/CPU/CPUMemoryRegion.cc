@@ -22,14 +22,126 @@
 
 #include "CPUMemoryRegion.hh"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+
+#include "common/Logging.hh"
+
 namespace phsa {
 
-CPUMemoryRegion::CPUMemoryRegion(hsa_region_segment_t Segment)
-    : RegionSegment(Segment) {}
+namespace {
+
+// The default huge page size on x86-64 and on arm64 with 4K base pages.
+const std::size_t DefaultHugePageSize = 2 * 1024 * 1024;
+
+std::size_t probeHugePageSize() {
+  std::ifstream PMDSize("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+  std::size_t Size = 0;
+  if (PMDSize >> Size && Size > 0)
+    return Size;
+  return DefaultHugePageSize;
+}
+
+// The size of the pages MAP_HUGETLB maps, which is the default hugetlbfs
+// page size and can differ from the transparent huge page size. Returns 0
+// in case it is not known.
+std::size_t probeHugeTLBPageSize() {
+  std::ifstream MemInfo("/proc/meminfo");
+  std::string Line;
+  while (std::getline(MemInfo, Line)) {
+    std::size_t KiB = 0;
+    if (std::sscanf(Line.c_str(), "Hugepagesize: %zu kB", &KiB) == 1)
+      return KiB * 1024;
+  }
+  return 0;
+}
+
+std::size_t roundUp(std::size_t Value, std::size_t Multiple) {
+  return (Value + Multiple - 1) / Multiple * Multiple;
+}
+
+} // namespace
+
+CPUMemoryRegion::CPUMemoryRegion(hsa_region_segment_t Segment, PageMode Mode)
+    : RegionSegment(Segment), Mode(Mode),
+      HugePageSize(Mode == PageMode::Default ? DefaultHugePageSize
+                                             : probeHugePageSize()),
+      HugeTLBPageSize(Mode == PageMode::HugeTLB ? probeHugeTLBPageSize()
+                                                : 0) {}
+
+CPUMemoryRegion::~CPUMemoryRegion() {
+  for (auto Mapping : HugePageAllocations)
+    munmap(Mapping.first, Mapping.second);
+}
+
+CPUMemoryRegion::PageMode CPUMemoryRegion::pageModeFromEnvironment() {
+  const char *HugePagesEnv = std::getenv("PHSA_HUGE_PAGES");
+  if (HugePagesEnv == nullptr)
+    return PageMode::Default;
+  if (std::strcmp(HugePagesEnv, "1") == 0 ||
+      std::strcmp(HugePagesEnv, "thp") == 0)
+    return PageMode::TransparentHuge;
+  if (std::strcmp(HugePagesEnv, "hugetlb") == 0)
+    return PageMode::HugeTLB;
+  return PageMode::Default;
+}
+
+// Maps Size bytes aligned to the huge page size. The caller must hold
+// AllocationsLock.
+void *CPUMemoryRegion::allocateHugePages(std::size_t Size, std::size_t Align) {
+#ifdef MAP_HUGETLB
+  // hugetlbfs mappings are whole pages of their own size, so allocations
+  // smaller than one are left to THP.
+  if (Mode == PageMode::HugeTLB && HugeTLBPageSize > 0 &&
+      Size >= HugeTLBPageSize && Align <= HugeTLBPageSize) {
+    std::size_t HugeTLBSize = roundUp(Size, HugeTLBPageSize);
+    void *Ptr = mmap(nullptr, HugeTLBSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (Ptr != MAP_FAILED) {
+      HugePageAllocations[Ptr] = HugeTLBSize;
+      return Ptr;
+    }
+    // No (or not enough) reserved huge pages, let THP try.
+  }
+#endif
+
+  std::size_t MappedSize = roundUp(Size, HugePageSize);
+
+  // Over-allocate so the start can be aligned to a huge page boundary,
+  // then return the unaligned head and tail back to the system.
+  std::size_t ReservedSize = MappedSize + HugePageSize;
+  void *Reserved = mmap(nullptr, ReservedSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Reserved == MAP_FAILED)
+    return nullptr;
+
+  std::size_t Start = reinterpret_cast<std::size_t>(Reserved);
+  std::size_t AlignedStart = roundUp(Start, HugePageSize);
+  std::size_t HeadSize = AlignedStart - Start;
+  std::size_t TailSize = ReservedSize - HeadSize - MappedSize;
+  if (HeadSize > 0)
+    munmap(Reserved, HeadSize);
+  if (TailSize > 0)
+    munmap(reinterpret_cast<void *>(AlignedStart + MappedSize), TailSize);
+
+  void *Ptr = reinterpret_cast<void *>(AlignedStart);
+#ifdef MADV_HUGEPAGE
+  if (madvise(Ptr, MappedSize, MADV_HUGEPAGE) != 0)
+    DEBUG << "madvise(MADV_HUGEPAGE) failed, using regular pages.";
+#endif
+  HugePageAllocations[Ptr] = MappedSize;
+  return Ptr;
+}
 
 void *CPUMemoryRegion::allocate(std::size_t Size, std::size_t Align) {
   void *Ptr = nullptr;
   std::lock_guard<std::mutex> Guard(AllocationsLock);
+  if (Mode != PageMode::Default && Size >= HugePageSize &&
+      Align <= HugePageSize)
+    return allocateHugePages(Size, Align);
   if (Align < sizeof(void *))
     Ptr = malloc(Size);
   else if (posix_memalign(&Ptr, Align, Size) != 0)
@@ -40,6 +152,12 @@ void *CPUMemoryRegion::allocate(std::size_t Size, std::size_t Align) {
 
 bool CPUMemoryRegion::free(void *Ptr) {
   std::lock_guard<std::mutex> Guard(AllocationsLock);
+  auto HugePageAllocation = HugePageAllocations.find(Ptr);
+  if (HugePageAllocation != HugePageAllocations.end()) {
+    munmap(Ptr, HugePageAllocation->second);
+    HugePageAllocations.erase(HugePageAllocation);
+    return true;
+  }
   if (Allocations.count(Ptr) > 0) {
     std::free(Ptr);
     Allocations.erase(Ptr);
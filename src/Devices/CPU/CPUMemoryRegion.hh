@@ -25,6 +25,7 @@
 #define HSA_RUNTIME_CPUMEMORYREGION_HH
 
 #include <cstdlib>
+#include <map>
 #include <set>
 #include <mutex>
 
@@ -35,7 +36,25 @@ namespace phsa {
 class CPUMemoryRegion : public MemoryRegion {
 
 public:
-  CPUMemoryRegion(hsa_region_segment_t Segment);
+  // The kind of pages used to back large allocations.
+  enum class PageMode {
+    // Regular pages returned by malloc().
+    Default,
+    // Huge page aligned anonymous mappings advised with MADV_HUGEPAGE.
+    TransparentHuge,
+    // Explicit hugetlbfs mappings. Falls back to TransparentHuge in case
+    // the system has no huge pages reserved.
+    HugeTLB
+  };
+
+  CPUMemoryRegion(hsa_region_segment_t Segment,
+                  PageMode Mode = PageMode::Default);
+  ~CPUMemoryRegion();
+
+  // Returns the page mode requested with the PHSA_HUGE_PAGES environment
+  // variable ("thp" or "1" for transparent huge pages, "hugetlb" for
+  // hugetlbfs).
+  static PageMode pageModeFromEnvironment();
 
   virtual void *allocate(std::size_t Size, std::size_t Align) override;
 
@@ -62,13 +81,26 @@ public:
 
   virtual bool getRuntimeAllocAllowed() const override { return true; }
 
+  // The allocations smaller than a huge page are not rounded up or
+  // aligned beyond the request also with huge pages enabled, so these do
+  // not depend on the page mode.
   virtual std::size_t getRuntimeAllocGranularity() const override { return 1; }
 
   virtual std::size_t getRuntimeAllocAlignment() const override { return 1; }
 
 private:
+  void *allocateHugePages(std::size_t Size, std::size_t Align);
+
   hsa_region_segment_t RegionSegment;
+  PageMode Mode;
+  // The transparent huge page size of the system, in bytes.
+  std::size_t HugePageSize;
+  // The default hugetlbfs page size in the HugeTLB mode, 0 otherwise.
+  std::size_t HugeTLBPageSize;
   std::set<void*> Allocations;
+  // Allocations backed by huge page mappings. Key = address, value = the
+  // size of the mapping.
+  std::map<void *, std::size_t> HugePageAllocations;
   std::mutex AllocationsLock;
 };
 
@@ -0,0 +1,251 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Memory copies between host accessible buffers for CPU-only platforms.
+ */
+
+#include "CopyEngine.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "Signal.hh"
+#include "common/Timestamp.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace phsa {
+
+namespace {
+
+// Copies smaller than this are not worth waking up the worker threads for.
+const std::size_t ParallelCopyThreshold = 4 * 1024 * 1024;
+// The minimum size of a chunk copied by a single thread.
+const std::size_t MinChunkSize = 1024 * 1024;
+// Copies larger than this are assumed to not fit in the last level cache,
+// thus the destination is written bypassing the caches.
+const std::size_t NonTemporalThreshold = 8 * 1024 * 1024;
+
+bool overlaps(const void *Dst, const void *Src, std::size_t Size) {
+  std::uintptr_t D = reinterpret_cast<std::uintptr_t>(Dst);
+  std::uintptr_t S = reinterpret_cast<std::uintptr_t>(Src);
+  return D < S + Size && S < D + Size;
+}
+
+// The scheduler is woken up by the changes of the signal values, but
+// checks the dependencies at least this often in case a signal is changed
+// without notifying SignalEvents.
+const std::chrono::milliseconds DependencyPollInterval(10);
+
+} // namespace
+
+CopyEngine::CopyEngine(ThreadPool &Workers)
+    : Workers(Workers), Scheduler(&CopyEngine::schedule, this) {}
+
+CopyEngine::~CopyEngine() {
+  {
+    std::lock_guard<std::mutex> L(PendingCopiesLock);
+    ShuttingDown = true;
+    wakeScheduler();
+  }
+  Scheduler.join();
+}
+
+void CopyEngine::wakeScheduler() {
+  if (SchedulerSleeping)
+    SignalEvents::notify();
+  else
+    CopiesSubmitted.notify_one();
+}
+
+void CopyEngine::copyChunk(void *Dst, const void *Src, std::size_t Size,
+                           bool NonTemporal) {
+#ifdef __SSE2__
+  if (NonTemporal) {
+    char *D = static_cast<char *>(Dst);
+    const char *S = static_cast<const char *>(Src);
+
+    // The streaming stores require 16B aligned destinations.
+    std::size_t Head = (16 - reinterpret_cast<std::uintptr_t>(D) % 16) % 16;
+    Head = std::min(Head, Size);
+    std::memcpy(D, S, Head);
+    D += Head;
+    S += Head;
+    Size -= Head;
+
+    std::size_t Blocks = Size / 64;
+    for (std::size_t I = 0; I < Blocks; ++I) {
+      __m128i A = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S));
+      __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S + 16));
+      __m128i C = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S + 32));
+      __m128i E = _mm_loadu_si128(reinterpret_cast<const __m128i *>(S + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(D), A);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(D + 16), B);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(D + 32), C);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(D + 48), E);
+      D += 64;
+      S += 64;
+    }
+    std::memcpy(D, S, Size % 64);
+    // Make the streamed data visible to the other threads before the
+    // copy is reported done.
+    _mm_sfence();
+    return;
+  }
+#endif
+  std::memcpy(Dst, Src, Size);
+}
+
+void CopyEngine::copy(void *Dst, const void *Src, std::size_t Size) {
+  if (Size < ParallelCopyThreshold || overlaps(Dst, Src, Size)) {
+    std::memmove(Dst, Src, Size);
+    return;
+  }
+
+  bool NonTemporal = Size >= NonTemporalThreshold;
+  std::size_t Chunks = chunkCount(Size);
+  // Keep the chunk boundaries cache line aligned so the threads do not
+  // write to the same lines.
+  std::size_t ChunkSize = (Size / Chunks + 63) / 64 * 64;
+
+  Workers.parallelFor(Chunks, [=](std::size_t I) {
+    std::size_t Offset = I * ChunkSize;
+    if (Offset >= Size)
+      return;
+    copyChunk(static_cast<char *>(Dst) + Offset,
+              static_cast<const char *>(Src) + Offset,
+              std::min(ChunkSize, Size - Offset), NonTemporal);
+  });
+}
+
+std::size_t CopyEngine::chunkCount(std::size_t Size) const {
+  if (Size < ParallelCopyThreshold)
+    return 1;
+  return std::min<std::size_t>(Workers.threadCount() + 1, Size / MinChunkSize);
+}
+
+void CopyEngine::copyAsync(void *Dst, const void *Src, std::size_t Size,
+                           std::vector<Signal *> Dependencies,
+                           Signal *Completion, bool Profile) {
+  {
+    std::lock_guard<std::mutex> L(PendingCopiesLock);
+    PendingCopies.push_back(AsyncCopy{Dst, Src, Size, std::move(Dependencies),
+                                      Completion, Profile && Completion});
+    wakeScheduler();
+  }
+}
+
+// Hands the chunks of the copy to the worker threads. The last chunk to
+// finish signals the completion.
+void CopyEngine::launch(AsyncCopy const &C) {
+  uint64_t StartTime = C.Profile ? Timestamp::now() : 0;
+  if (Workers.threadCount() == 0) {
+    copy(C.Dst, C.Src, C.Size);
+    if (C.Completion == nullptr)
+      return;
+    if (C.Profile)
+      C.Completion->setProfilingTimes(StartTime, Timestamp::now());
+    C.Completion->subtract(1, MemoryOrder::Release);
+    return;
+  }
+
+  bool Overlapping = overlaps(C.Dst, C.Src, C.Size);
+  std::size_t Chunks = Overlapping ? 1 : chunkCount(C.Size);
+  std::size_t ChunkSize = (C.Size / Chunks + 63) / 64 * 64;
+  bool NonTemporal = C.Size >= NonTemporalThreshold;
+  auto RemainingChunks = std::make_shared<std::atomic<std::size_t>>(Chunks);
+
+  for (std::size_t I = 0; I < Chunks; ++I) {
+    std::size_t Offset = I * ChunkSize;
+    std::size_t Size = Offset < C.Size ? std::min(ChunkSize, C.Size - Offset)
+                                       : 0;
+    char *Dst = static_cast<char *>(C.Dst) + Offset;
+    const char *Src = static_cast<const char *>(C.Src) + Offset;
+    Signal *Completion = C.Completion;
+    bool Profile = C.Profile;
+    Workers.submit([=]() {
+      if (Overlapping)
+        std::memmove(Dst, Src, Size);
+      else if (Size > 0)
+        copyChunk(Dst, Src, Size, NonTemporal);
+      if (RemainingChunks->fetch_sub(1) != 1 || Completion == nullptr)
+        return;
+      if (Profile)
+        Completion->setProfilingTimes(StartTime, Timestamp::now());
+      Completion->subtract(1, MemoryOrder::Release);
+    });
+  }
+}
+
+void CopyEngine::schedule() {
+  std::unique_lock<std::mutex> L(PendingCopiesLock);
+  while (true) {
+    if (PendingCopies.empty()) {
+      if (ShuttingDown)
+        return;
+      CopiesSubmitted.wait(L);
+      continue;
+    }
+
+    // Registered as a sleeper before checking the dependencies so that no
+    // change made after the check is missed.
+    uint64_t ChangeCount = SignalEvents::prepareSleep();
+    for (auto It = PendingCopies.begin(); It != PendingCopies.end();) {
+      bool Ready = std::all_of(
+          It->Dependencies.begin(), It->Dependencies.end(),
+          [](Signal *S) { return S->load(MemoryOrder::Acquire) == 0; });
+      if (Ready) {
+        launch(*It);
+        It = PendingCopies.erase(It);
+      } else {
+        ++It;
+      }
+    }
+
+    // The copies whose dependencies are still unsatisfied at shutdown are
+    // dropped: their sources might be incomplete and their destinations
+    // freed already. Their completion signals are left untouched.
+    if (ShuttingDown) {
+      SignalEvents::cancelSleep();
+      PendingCopies.clear();
+      return;
+    }
+
+    if (PendingCopies.empty()) {
+      SignalEvents::cancelSleep();
+      continue;
+    }
+
+    // New copies and the shutdown wake the scheduler up through
+    // SignalEvents while it sleeps there.
+    SchedulerSleeping = true;
+    L.unlock();
+    SignalEvents::sleep(ChangeCount, DependencyPollInterval);
+    L.lock();
+    SchedulerSleeping = false;
+  }
+}
+
+} // namespace phsa
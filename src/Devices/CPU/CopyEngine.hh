@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Memory copies between host accessible buffers for CPU-only platforms.
+ */
+
+#ifndef HSA_RUNTIME_COPYENGINE_HH
+#define HSA_RUNTIME_COPYENGINE_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/ThreadPool.hh"
+
+namespace phsa {
+
+class Signal;
+
+// Copies large buffers by splitting them to chunks copied in parallel by
+// the host worker threads. Chunks larger than the last level cache are
+// written using non-temporal stores to avoid evicting the working set of
+// the kernels. Small and overlapping copies use memmove().
+//
+// Asynchronous copies are kept in a pending list by a scheduler thread
+// until their dependency signals are satisfied, after which their chunks
+// are handed to the worker threads. While copies are pending, the
+// scheduler sleeps in SignalEvents until a signal value changes. The
+// copies still waiting for their dependencies at shutdown are dropped.
+class CopyEngine {
+public:
+  CopyEngine(ThreadPool &Workers);
+  ~CopyEngine();
+
+  // Copies Size bytes from Src to Dst. The ranges may overlap.
+  void copy(void *Dst, const void *Src, std::size_t Size);
+
+  // Copies Size bytes from Src to Dst in the background once all the
+  // Dependencies have reached zero. Completion, if given, is decremented
+  // by one once the copy has finished. In case Profile is set, the start
+  // and end timestamps of the copy are recorded to Completion.
+  void copyAsync(void *Dst, const void *Src, std::size_t Size,
+                 std::vector<Signal *> Dependencies, Signal *Completion,
+                 bool Profile = false);
+
+private:
+  struct AsyncCopy {
+    void *Dst;
+    const void *Src;
+    std::size_t Size;
+    std::vector<Signal *> Dependencies;
+    Signal *Completion;
+    bool Profile;
+  };
+
+  // Copies a chunk of non-overlapping memory.
+  static void copyChunk(void *Dst, const void *Src, std::size_t Size,
+                        bool NonTemporal);
+
+  // The number of chunks a copy of the given size is split to.
+  std::size_t chunkCount(std::size_t Size) const;
+
+  void launch(AsyncCopy const &C);
+  void schedule();
+  // Wakes up the scheduler to see a new copy or the shutdown. Called with
+  // PendingCopiesLock held.
+  void wakeScheduler();
+
+  ThreadPool &Workers;
+
+  std::list<AsyncCopy> PendingCopies;
+  std::mutex PendingCopiesLock;
+  std::condition_variable CopiesSubmitted;
+  bool ShuttingDown = false;
+  // Whether the scheduler sleeps in SignalEvents instead of waiting for
+  // CopiesSubmitted.
+  bool SchedulerSleeping = false;
+  std::thread Scheduler;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_COPYENGINE_HH
@@ -24,6 +24,7 @@
 #include "MemoryRegion.hh"
 #include "common/Logging.hh"
 #include "common/Atomic.hh"
+#include "common/Timestamp.hh"
 
 namespace phsa {
 
@@ -72,13 +73,14 @@ void GCCBuiltinSignal::store(hsa_signal_value_t Value, MemoryOrder MO) {
   switch (MO) {
   case MemoryOrder::Relaxed:
     storeRelaxed(Value);
-    return;
+    break;
   case MemoryOrder::Release:
     storeRelease(Value);
-    return;
+    break;
   default:
     ABORT_UNIMPLEMENTED;
   }
+  SignalEvents::notify();
 }
 
 void GCCBuiltinSignal::storeRelaxed(hsa_signal_value_t Value) {
@@ -98,15 +100,12 @@ hsa_signal_value_t
 GCCBuiltinSignal::wait(UnaryPredicate Condition,
                        std::chrono::high_resolution_clock::duration Timeout,
                        MemoryOrder MO) {
-
-  std::function<std::chrono::high_resolution_clock::time_point(void)> Now =
-      []() { return std::chrono::high_resolution_clock::now(); };
-  std::chrono::high_resolution_clock::time_point StartTime = Now();
+  uint64_t Deadline = Timestamp::deadline(Timeout);
 
   hsa_signal_value_t Value;
   do {
     Value = load(MO);
-    if (Now() - StartTime > Timeout)
+    if (Timestamp::now() > Deadline)
       break;
   } while (!Condition(Value));
 
@@ -115,7 +114,10 @@ GCCBuiltinSignal::wait(UnaryPredicate Condition,
 
 hsa_signal_value_t GCCBuiltinSignal::exchange(hsa_signal_value_t Value,
                                               MemoryOrder MO) {
-  return Atomic::Exchange(Value, (hsa_signal_value_t *)CurrentValue, MO);
+  hsa_signal_value_t Old =
+      Atomic::Exchange(Value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
+  return Old;
 }
 
 hsa_signal_value_t
@@ -123,27 +125,33 @@ GCCBuiltinSignal::compareExchange(hsa_signal_value_t Expected,
                                   hsa_signal_value_t Value, MemoryOrder MO) {
   Atomic::CompareExchange((hsa_signal_value_t *)CurrentValue, &Expected, Value,
                           MO);
+  SignalEvents::notify();
   return Expected;
 }
 
 void GCCBuiltinSignal::subtract(hsa_signal_value_t value, MemoryOrder MO) {
   Atomic::FetchSub(value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
 }
 
 void GCCBuiltinSignal::add(hsa_signal_value_t value, MemoryOrder MO) {
   Atomic::FetchAdd(value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
 }
 
 void GCCBuiltinSignal::xor_(hsa_signal_value_t value, MemoryOrder MO) {
   Atomic::FetchXor(value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
 }
 
 void GCCBuiltinSignal::and_(hsa_signal_value_t value, MemoryOrder MO) {
   Atomic::FetchAnd(value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
 }
 
 void GCCBuiltinSignal::or_(hsa_signal_value_t value, MemoryOrder MO) {
   Atomic::FetchOr(value, (hsa_signal_value_t *)CurrentValue, MO);
+  SignalEvents::notify();
 }
 
 } // namespace phsa
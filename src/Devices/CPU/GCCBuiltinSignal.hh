@@ -72,6 +72,10 @@ public:
                                              hsa_signal_value_t Value,
                                              MemoryOrder MO) override;
 
+  virtual const volatile hsa_signal_value_t *valueAddress() const override {
+    return CurrentValue;
+  }
+
 private:
   void storeRelease(hsa_signal_value_t Value);
   void storeRelaxed(hsa_signal_value_t Value);
@@ -0,0 +1,225 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Registration, pre-faulting and pinning of host memory for CPU-only
+ * platforms.
+ */
+
+#include "HostMemoryRegistry.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common/Logging.hh"
+
+namespace phsa {
+
+namespace {
+
+// Touch at least this many pages per parallel prefaulting task.
+const std::size_t MinPagesPerTask = 256;
+
+bool isEnabled(const char *Name) {
+  const char *Value = std::getenv(Name);
+  return Value != nullptr && std::strcmp(Value, "0") != 0;
+}
+
+// Returns true in case [Begin, End) is covered by writable mappings of
+// the process.
+bool isWritable(std::uintptr_t Begin, std::uintptr_t End) {
+  std::ifstream Maps("/proc/self/maps");
+  std::string Line;
+  std::uintptr_t Cursor = Begin;
+  while (Cursor < End && std::getline(Maps, Line)) {
+    unsigned long MapBegin, MapEnd;
+    char Permissions[5];
+    if (std::sscanf(Line.c_str(), "%lx-%lx %4s", &MapBegin, &MapEnd,
+                    Permissions) != 3 ||
+        MapEnd <= Cursor)
+      continue;
+    // The mappings are sorted, so a gap or a read-only mapping ends the
+    // writable range.
+    if (MapBegin > Cursor || Permissions[1] != 'w')
+      return false;
+    Cursor = MapEnd;
+  }
+  return Cursor >= End;
+}
+
+} // namespace
+
+HostMemoryRegistry::HostMemoryRegistry(ThreadPool &Workers,
+                                       unsigned DefaultFlags)
+    : Workers(Workers), DefaultFlags(DefaultFlags),
+      PageSize(sysconf(_SC_PAGESIZE)) {}
+
+HostMemoryRegistry::~HostMemoryRegistry() {
+  for (auto &R : Registrations)
+    if (R.second.Locked)
+      munlock(reinterpret_cast<void *>(R.first), R.second.Size);
+}
+
+unsigned HostMemoryRegistry::flagsFromEnvironment() {
+  unsigned Flags = 0;
+  if (isEnabled("PHSA_REGISTER_PREFAULT"))
+    Flags |= Prefault;
+  if (isEnabled("PHSA_REGISTER_LOCK"))
+    Flags |= Lock;
+  return Flags;
+}
+
+hsa_status_t HostMemoryRegistry::registerBuffer(void *Ptr, std::size_t Size,
+                                                unsigned Flags) {
+  Flags |= DefaultFlags;
+  std::uintptr_t Begin = reinterpret_cast<std::uintptr_t>(Ptr);
+
+  // The registration is recorded under the lock, but the buffer is
+  // prefaulted and locked without it so that the other registrations do
+  // not wait for it. The reference taken here keeps the entry alive.
+  std::uintptr_t NewBegin = Begin;
+  bool WasLocked, Locking;
+  {
+    std::lock_guard<std::mutex> L(RegistrationsLock);
+    auto It = Registrations.find(Begin);
+    if (It == Registrations.end()) {
+      It = Registrations
+               .insert(std::make_pair(Begin, Registration{0, 0, false}))
+               .first;
+    } else {
+      NewBegin = Begin + It->second.Size;
+    }
+    Registration &R = It->second;
+    ++R.RefCount;
+    if (Size <= R.Size)
+      return HSA_STATUS_SUCCESS;
+    R.Size = Size;
+    WasLocked = R.Locked;
+    Locking = (Flags & Lock) || R.Locked;
+    // Marked before locking so that a concurrent deregistration of an
+    // overlapping buffer does not unlock the shared pages.
+    R.Locked = Locking;
+  }
+
+  std::uintptr_t End = Begin + Size;
+  if (Flags & Prefault)
+    prefault(NewBegin, End);
+  // Pinning is best effort: the buffer stays usable even if the locked
+  // memory limit does not allow locking it.
+  if (Locking && !lock(Begin, End)) {
+    DEBUG << "Could not lock " << Size << " bytes at " << Ptr << ": "
+          << std::strerror(errno);
+    std::lock_guard<std::mutex> L(RegistrationsLock);
+    auto It = Registrations.find(Begin);
+    if (It != Registrations.end() && !WasLocked)
+      It->second.Locked = false;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HostMemoryRegistry::deregisterBuffer(void *Ptr) {
+  std::uintptr_t Begin = reinterpret_cast<std::uintptr_t>(Ptr);
+
+  std::lock_guard<std::mutex> L(RegistrationsLock);
+  auto It = Registrations.find(Begin);
+  if (It == Registrations.end())
+    return HSA_STATUS_SUCCESS;
+
+  Registration &R = It->second;
+  if (--R.RefCount > 0)
+    return HSA_STATUS_SUCCESS;
+
+  if (R.Locked)
+    unlock(Begin, Begin + R.Size, Begin);
+  Registrations.erase(It);
+  return HSA_STATUS_SUCCESS;
+}
+
+void HostMemoryRegistry::prefault(std::uintptr_t Begin, std::uintptr_t End) {
+  std::uintptr_t First = Begin / PageSize * PageSize;
+  std::size_t Length = End - First;
+  void *Start = reinterpret_cast<void *>(First);
+
+  // Let the kernel populate the page tables if it can. Read-only
+  // mappings can only be populated for reading.
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(Start, Length, MADV_POPULATE_WRITE) == 0 ||
+      madvise(Start, Length, MADV_POPULATE_READ) == 0)
+    return;
+#endif
+
+  // Otherwise start the read-ahead and touch the pages in parallel. A read
+  // of a page never written maps the shared zero page, so the pages are
+  // touched with a write that does not change their contents, unless the
+  // buffer is read-only.
+  madvise(Start, Length, MADV_WILLNEED);
+  bool Write = isWritable(First, End);
+  std::size_t Pages = (Length + PageSize - 1) / PageSize;
+  std::size_t Tasks = std::max<std::size_t>(
+      1, std::min<std::size_t>(Workers.threadCount() + 1,
+                               Pages / MinPagesPerTask));
+  std::size_t PagesPerTask = (Pages + Tasks - 1) / Tasks;
+  std::size_t PageSize = this->PageSize;
+  Workers.parallelFor(Tasks, [=](std::size_t Task) {
+    std::size_t Last = std::min(Pages, (Task + 1) * PagesPerTask);
+    for (std::size_t Page = Task * PagesPerTask; Page < Last; ++Page) {
+      char *Byte =
+          reinterpret_cast<char *>(std::max(Begin, First + Page * PageSize));
+      // Atomic so that concurrent writes of the application are not lost.
+      if (Write)
+        __atomic_fetch_add(Byte, 0, __ATOMIC_RELAXED);
+      else
+        (void)*reinterpret_cast<volatile const char *>(Byte);
+    }
+  });
+}
+
+bool HostMemoryRegistry::lock(std::uintptr_t Begin, std::uintptr_t End) {
+  return mlock(reinterpret_cast<void *>(Begin), End - Begin) == 0;
+}
+
+void HostMemoryRegistry::unlock(std::uintptr_t Begin, std::uintptr_t End,
+                                std::uintptr_t Except) {
+  // Locks do not nest, so keep the pages shared with other locked
+  // registrations locked.
+  std::uintptr_t Cursor = Begin / PageSize * PageSize;
+  std::uintptr_t Limit = (End + PageSize - 1) / PageSize * PageSize;
+  for (auto &Other : Registrations) {
+    if (Other.first == Except || !Other.second.Locked)
+      continue;
+    std::uintptr_t OtherBegin = Other.first / PageSize * PageSize;
+    std::uintptr_t OtherEnd =
+        (Other.first + Other.second.Size + PageSize - 1) / PageSize * PageSize;
+    if (OtherEnd <= Cursor || OtherBegin >= Limit)
+      continue;
+    if (OtherBegin > Cursor)
+      munlock(reinterpret_cast<void *>(Cursor), OtherBegin - Cursor);
+    Cursor = std::max(Cursor, OtherEnd);
+  }
+  if (Cursor < Limit)
+    munlock(reinterpret_cast<void *>(Cursor), Limit - Cursor);
+}
+
+} // namespace phsa
@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Registration, pre-faulting and pinning of host memory for CPU-only
+ * platforms.
+ */
+
+#ifndef HSA_RUNTIME_HOSTMEMORYREGISTRY_HH
+#define HSA_RUNTIME_HOSTMEMORYREGISTRY_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include "hsa.h"
+#include "common/ThreadPool.hh"
+
+namespace phsa {
+
+// Keeps track of the host buffers registered to the runtime. On
+// registration the pages of the buffer can be faulted in up front and
+// locked to memory so kernels touching the buffer do not pay for page
+// faults. Deregistration unlocks the pages that are not covered by other
+// locked registrations.
+class HostMemoryRegistry {
+public:
+  enum RegistrationFlags {
+    Prefault = 1 << 0,
+    Lock = 1 << 1
+  };
+
+  // DefaultFlags are applied to all registrations.
+  HostMemoryRegistry(ThreadPool &Workers, unsigned DefaultFlags);
+  ~HostMemoryRegistry();
+
+  // Registers the buffer at Ptr. Registering the same pointer again only
+  // increases its reference count, and grows the range if Size is larger.
+  hsa_status_t registerBuffer(void *Ptr, std::size_t Size, unsigned Flags);
+  hsa_status_t deregisterBuffer(void *Ptr);
+
+  // Reads the default flags from PHSA_REGISTER_PREFAULT and
+  // PHSA_REGISTER_LOCK.
+  static unsigned flagsFromEnvironment();
+
+private:
+  struct Registration {
+    std::size_t Size;
+    unsigned RefCount;
+    bool Locked;
+  };
+
+  void prefault(std::uintptr_t Begin, std::uintptr_t End);
+  bool lock(std::uintptr_t Begin, std::uintptr_t End);
+  // Unlocks the pages of [Begin, End) that are not locked by another
+  // registration than Except.
+  void unlock(std::uintptr_t Begin, std::uintptr_t End, std::uintptr_t Except);
+
+  ThreadPool &Workers;
+  unsigned DefaultFlags;
+  std::size_t PageSize;
+  std::map<std::uintptr_t, Registration> Registrations;
+  std::mutex RegistrationsLock;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_HOSTMEMORYREGISTRY_HH
@@ -0,0 +1,794 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Image element formats of the CPU images.
+ */
+
+#include "ImageFormat.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace phsa {
+
+namespace {
+
+// The channels stored in an element of each channel order. Components
+// maps the storage channels to the r, g, b and a access components, and
+// Sources maps the access components back to the storage channels. -1
+// marks an unused channel or a missing component.
+struct ChannelOrderInfo {
+  uint8_t Count;
+  int8_t Components[4];
+  int8_t Sources[4];
+};
+
+const ChannelOrderInfo ChannelOrders[] = {
+    {1, {3}, {-1, -1, -1, 0}},              // A
+    {1, {0}, {0, -1, -1, -1}},              // R
+    {2, {0, -1}, {0, -1, -1, -1}},          // RX
+    {2, {0, 1}, {0, 1, -1, -1}},            // RG
+    {3, {0, 1, -1}, {0, 1, -1, -1}},        // RGX
+    {2, {0, 3}, {0, -1, -1, 1}},            // RA
+    {3, {0, 1, 2}, {0, 1, 2, -1}},          // RGB
+    {4, {0, 1, 2, -1}, {0, 1, 2, -1}},      // RGBX
+    {4, {0, 1, 2, 3}, {0, 1, 2, 3}},        // RGBA
+    {4, {2, 1, 0, 3}, {2, 1, 0, 3}},        // BGRA
+    {4, {3, 0, 1, 2}, {1, 2, 3, 0}},        // ARGB
+    {4, {3, 2, 1, 0}, {3, 2, 1, 0}},        // ABGR
+    {3, {0, 1, 2}, {0, 1, 2, -1}},          // SRGB
+    {4, {0, 1, 2, -1}, {0, 1, 2, -1}},      // SRGBX
+    {4, {0, 1, 2, 3}, {0, 1, 2, 3}},        // SRGBA
+    {4, {2, 1, 0, 3}, {2, 1, 0, 3}},        // SBGRA
+    {1, {0}, {0, 0, 0, 0}},                 // INTENSITY
+    {1, {0}, {0, 0, 0, -1}},                // LUMINANCE
+    {1, {0}, {0, -1, -1, -1}},              // DEPTH
+    {2, {0, -1}, {0, -1, -1, -1}}           // DEPTH_STENCIL
+};
+
+// The size of a channel of each channel type in bytes. The packed types
+// and UNORM_INT24 have no per channel size.
+const uint8_t ChannelTypeSizes[] = {1, 2, 1, 2, 0, 0, 0, 0,
+                                    1, 2, 4, 1, 2, 4, 2, 4};
+
+// The number of elements converted at a time through the stack buffers.
+const std::size_t BlockSize = 64;
+
+const uint32_t FloatOne = 0x3f800000;
+
+bool isSRGB(hsa_ext_image_channel_order_t Order) {
+  return Order >= HSA_EXT_IMAGE_CHANNEL_ORDER_SRGB &&
+         Order <= HSA_EXT_IMAGE_CHANNEL_ORDER_SBGRA;
+}
+
+bool isDepth(hsa_ext_image_channel_order_t Order) {
+  return Order == HSA_EXT_IMAGE_CHANNEL_ORDER_DEPTH ||
+         Order == HSA_EXT_IMAGE_CHANNEL_ORDER_DEPTH_STENCIL;
+}
+
+bool isInteger(hsa_ext_image_channel_type_t Type) {
+  return Type >= HSA_EXT_IMAGE_CHANNEL_TYPE_SIGNED_INT8 &&
+         Type <= HSA_EXT_IMAGE_CHANNEL_TYPE_UNSIGNED_INT32;
+}
+
+bool isPacked(hsa_ext_image_channel_type_t Type) {
+  return Type >= HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_SHORT_555 &&
+         Type <= HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_SHORT_101010;
+}
+
+// 0 for float, 1 for signed and 2 for unsigned access values.
+int accessType(hsa_ext_image_channel_type_t Type) {
+  if (Type >= HSA_EXT_IMAGE_CHANNEL_TYPE_UNSIGNED_INT8 &&
+      Type <= HSA_EXT_IMAGE_CHANNEL_TYPE_UNSIGNED_INT32)
+    return 2;
+  return isInteger(Type) ? 1 : 0;
+}
+
+// The number of stored channels codecs see per element. UNORM_INT24
+// elements are a single 32-bit channel.
+unsigned channelCount(const hsa_ext_image_format_t &Format) {
+  if (Format.channel_type == HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT24)
+    return 1;
+  return ChannelOrders[Format.channel_order].Count;
+}
+
+std::size_t channelSize(hsa_ext_image_channel_type_t Type) {
+  if (Type == HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT24)
+    return 4;
+  return ChannelTypeSizes[Type];
+}
+
+float asFloat(uint32_t Value) {
+  float F;
+  std::memcpy(&F, &Value, sizeof(F));
+  return F;
+}
+
+uint32_t asBits(float F) {
+  uint32_t Value;
+  std::memcpy(&Value, &F, sizeof(Value));
+  return Value;
+}
+
+template <typename T> T load(const uint8_t *Src) {
+  T Value;
+  std::memcpy(&Value, Src, sizeof(T));
+  return Value;
+}
+
+template <typename T> void store(uint8_t *Dst, T Value) {
+  std::memcpy(Dst, &Value, sizeof(T));
+}
+
+// The vector kernels compute the same float operations in the same order
+// so they give the same results as these.
+uint32_t toUnorm(float F, uint32_t Max) {
+  if (!(F > 0.0f))
+    return 0;
+  if (F >= 1.0f)
+    return Max;
+  return static_cast<uint32_t>(F * static_cast<float>(Max) + 0.5f);
+}
+
+int32_t toSnorm(float F, int32_t Max) {
+  if (F != F)
+    return 0;
+  if (F <= -1.0f)
+    return -Max;
+  if (F >= 1.0f)
+    return Max;
+  return static_cast<int32_t>(std::floor(F * static_cast<float>(Max) + 0.5f));
+}
+
+float toSRGB(float F) {
+  if (!(F > 0.0031308f))
+    return 12.92f * F;
+  return 1.055f * std::pow(F, 1.0f / 2.4f) - 0.055f;
+}
+
+float fromSRGB(float F) {
+  if (!(F > 0.04045f))
+    return F / 12.92f;
+  return std::pow((F + 0.055f) / 1.055f, 2.4f);
+}
+
+// Rounds to the nearest even half precision value.
+uint16_t toHalf(float F) {
+  uint32_t Bits = asBits(F);
+  uint32_t Sign = (Bits >> 16) & 0x8000;
+  uint32_t Exponent = (Bits >> 23) & 0xff;
+  uint32_t Mantissa = Bits & 0x7fffff;
+
+  if (Exponent == 0xff)
+    return Sign | 0x7c00 | (Mantissa ? 0x200 : 0);
+
+  int32_t E = static_cast<int32_t>(Exponent) - 127 + 15;
+  if (E >= 0x1f)
+    return Sign | 0x7c00;
+
+  uint32_t Shift = 13;
+  uint32_t H;
+  if (E <= 0) {
+    if (E < -10)
+      return Sign;
+    Mantissa |= 0x800000;
+    Shift = 14 - E;
+    H = Mantissa >> Shift;
+  } else {
+    H = (static_cast<uint32_t>(E) << 10) | (Mantissa >> Shift);
+  }
+  uint32_t Rest = Mantissa & ((1u << Shift) - 1);
+  uint32_t Halfway = 1u << (Shift - 1);
+  // A carry out of the mantissa correctly bumps the exponent.
+  if (Rest > Halfway || (Rest == Halfway && (H & 1)))
+    ++H;
+  return Sign | H;
+}
+
+float fromHalf(uint16_t H) {
+  uint32_t Sign = static_cast<uint32_t>(H & 0x8000) << 16;
+  uint32_t Exponent = (H >> 10) & 0x1f;
+  uint32_t Mantissa = H & 0x3ff;
+
+  if (Exponent == 0x1f)
+    return asFloat(Sign | 0x7f800000 | (Mantissa << 13));
+  if (Exponent == 0) {
+    // Zeros and subnormals are exact in float.
+    float F = std::ldexp(static_cast<float>(Mantissa), -24);
+    return Sign ? -F : F;
+  }
+  return asFloat(Sign | ((Exponent + 127 - 15) << 23) | (Mantissa << 13));
+}
+
+// Codecs convert between the stored channels and their access values.
+// The packed channel types convert whole elements to and from the four
+// access values instead.
+typedef void (*DecodeFunction)(const uint8_t *Src, uint32_t *Dst,
+                               std::size_t Count);
+typedef void (*EncodeFunction)(const uint32_t *Src, uint8_t *Dst,
+                               std::size_t Count);
+
+struct ChannelTypeCodec {
+  DecodeFunction Decode;
+  EncodeFunction Encode;
+};
+
+template <typename T>
+void decodeInteger(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    Dst[I] = static_cast<uint32_t>(
+        static_cast<int32_t>(load<T>(Src + I * sizeof(T))));
+}
+
+// Keeps the low bits, as hsa_ext_image_clear does for integers.
+template <typename T>
+void encodeInteger(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    store<T>(Dst + I * sizeof(T), static_cast<T>(Src[I]));
+}
+
+template <typename T, uint32_t Max>
+void decodeUnorm(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    Dst[I] = asBits(static_cast<float>(load<T>(Src + I * sizeof(T))) /
+                    static_cast<float>(Max));
+}
+
+template <typename T, uint32_t Max>
+void encodeUnorm(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    store<T>(Dst + I * sizeof(T), toUnorm(asFloat(Src[I]), Max));
+}
+
+template <typename T, int32_t Max>
+void decodeSnorm(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    Dst[I] = asBits(std::max(static_cast<float>(load<T>(Src + I * sizeof(T))) /
+                                 static_cast<float>(Max),
+                             -1.0f));
+}
+
+template <typename T, int32_t Max>
+void encodeSnorm(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    store<T>(Dst + I * sizeof(T), toSnorm(asFloat(Src[I]), Max));
+}
+
+void decodeUnorm24(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    Dst[I] = asBits(static_cast<float>(
+        static_cast<double>(load<uint32_t>(Src + I * 4) & 0xffffff) /
+        0xffffff));
+}
+
+// The stencil bits are cleared.
+void encodeUnorm24(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I) {
+    float F = asFloat(Src[I]);
+    uint32_t Value = 0;
+    if (F >= 1.0f)
+      Value = 0xffffff;
+    else if (F > 0.0f)
+      Value = static_cast<uint32_t>(static_cast<double>(F) * 0xffffff + 0.5);
+    store<uint32_t>(Dst + I * 4, Value);
+  }
+}
+
+void decodeHalf(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    Dst[I] = asBits(fromHalf(load<uint16_t>(Src + I * 2)));
+}
+
+void encodeHalf(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I)
+    store<uint16_t>(Dst + I * 2, toHalf(asFloat(Src[I])));
+}
+
+void decode32(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  std::memcpy(Dst, Src, Count * 4);
+}
+
+void encode32(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  std::memcpy(Dst, Src, Count * 4);
+}
+
+// Packed RGB elements with the channel widths R, G and B from the most to
+// the least significant bits.
+template <typename T, unsigned R, unsigned G, unsigned B>
+void decodePacked(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I, Dst += 4) {
+    uint32_t Value = load<T>(Src + I * sizeof(T));
+    Dst[0] = asBits(static_cast<float>((Value >> (G + B)) & ((1u << R) - 1)) /
+                    ((1u << R) - 1));
+    Dst[1] = asBits(static_cast<float>((Value >> B) & ((1u << G) - 1)) /
+                    ((1u << G) - 1));
+    Dst[2] = asBits(static_cast<float>(Value & ((1u << B) - 1)) /
+                    ((1u << B) - 1));
+    Dst[3] = FloatOne;
+  }
+}
+
+template <typename T, unsigned R, unsigned G, unsigned B>
+void encodePacked(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  for (std::size_t I = 0; I < Count; ++I, Src += 4)
+    store<T>(Dst + I * sizeof(T),
+             toUnorm(asFloat(Src[0]), (1u << R) - 1) << (G + B) |
+                 toUnorm(asFloat(Src[1]), (1u << G) - 1) << B |
+                 toUnorm(asFloat(Src[2]), (1u << B) - 1));
+}
+
+// Vector kernels of the most common conversions, between 8 and 16-bit
+// unorm channels and floats.
+
+#ifdef __SSE2__
+
+void decodeUnorm8SSE2(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  const __m128 Scale = _mm_set1_ps(255.0f);
+  const __m128i Zero = _mm_setzero_si128();
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    __m128i V = _mm_cvtsi32_si128(load<int32_t>(Src + I));
+    V = _mm_unpacklo_epi16(_mm_unpacklo_epi8(V, Zero), Zero);
+    _mm_storeu_ps(reinterpret_cast<float *>(Dst + I),
+                  _mm_div_ps(_mm_cvtepi32_ps(V), Scale));
+  }
+  decodeUnorm<uint8_t, 255>(Src + I, Dst + I, Count - I);
+}
+
+void encodeUnorm8SSE2(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  const __m128 Zero = _mm_setzero_ps(), One = _mm_set1_ps(1.0f);
+  const __m128 Scale = _mm_set1_ps(255.0f), Half = _mm_set1_ps(0.5f);
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    __m128 F = _mm_loadu_ps(reinterpret_cast<const float *>(Src + I));
+    // Takes the second operand for NaNs.
+    F = _mm_min_ps(_mm_max_ps(F, Zero), One);
+    __m128i V = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(F, Scale), Half));
+    V = _mm_packus_epi16(_mm_packs_epi32(V, V), V);
+    store<int32_t>(Dst + I, _mm_cvtsi128_si32(V));
+  }
+  encodeUnorm<uint8_t, 255>(Src + I, Dst + I, Count - I);
+}
+
+void decodeUnorm16SSE2(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  const __m128 Scale = _mm_set1_ps(65535.0f);
+  const __m128i Zero = _mm_setzero_si128();
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    __m128i V =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(Src + I * 2));
+    V = _mm_unpacklo_epi16(V, Zero);
+    _mm_storeu_ps(reinterpret_cast<float *>(Dst + I),
+                  _mm_div_ps(_mm_cvtepi32_ps(V), Scale));
+  }
+  decodeUnorm<uint16_t, 65535>(Src + I * 2, Dst + I, Count - I);
+}
+
+void encodeUnorm16SSE2(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  const __m128 Zero = _mm_setzero_ps(), One = _mm_set1_ps(1.0f);
+  const __m128 Scale = _mm_set1_ps(65535.0f), Half = _mm_set1_ps(0.5f);
+  const __m128i Bias = _mm_set1_epi32(0x8000);
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    __m128 F = _mm_loadu_ps(reinterpret_cast<const float *>(Src + I));
+    F = _mm_min_ps(_mm_max_ps(F, Zero), One);
+    __m128i V = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(F, Scale), Half));
+    // SSE2 only packs with signed saturation, so the values are biased
+    // to the signed range and back.
+    V = _mm_packs_epi32(_mm_sub_epi32(V, Bias), _mm_setzero_si128());
+    V = _mm_xor_si128(V, _mm_set1_epi16(static_cast<int16_t>(0x8000)));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(Dst + I * 2), V);
+  }
+  encodeUnorm<uint16_t, 65535>(Src + I, Dst + I * 2, Count - I);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 void decodeUnorm8AVX2(const uint8_t *Src, uint32_t *Dst,
+                           std::size_t Count) {
+  const __m256 Scale = _mm256_set1_ps(255.0f);
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    __m256i V = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(Src + I)));
+    _mm256_storeu_ps(reinterpret_cast<float *>(Dst + I),
+                     _mm256_div_ps(_mm256_cvtepi32_ps(V), Scale));
+  }
+  decodeUnorm8SSE2(Src + I, Dst + I, Count - I);
+}
+
+AVX2 void encodeUnorm8AVX2(const uint32_t *Src, uint8_t *Dst,
+                           std::size_t Count) {
+  const __m256 Zero = _mm256_setzero_ps(), One = _mm256_set1_ps(1.0f);
+  const __m256 Scale = _mm256_set1_ps(255.0f), Half = _mm256_set1_ps(0.5f);
+  const __m256i Gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    __m256 F = _mm256_loadu_ps(reinterpret_cast<const float *>(Src + I));
+    F = _mm256_min_ps(_mm256_max_ps(F, Zero), One);
+    __m256i V =
+        _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(F, Scale), Half));
+    // The packs work within the 128-bit lanes, leaving the bytes in the
+    // low words of the lanes.
+    V = _mm256_packus_epi16(_mm256_packs_epi32(V, V), V);
+    V = _mm256_permutevar8x32_epi32(V, Gather);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(Dst + I),
+                     _mm256_castsi256_si128(V));
+  }
+  encodeUnorm8SSE2(Src + I, Dst + I, Count - I);
+}
+
+AVX2 void decodeUnorm16AVX2(const uint8_t *Src, uint32_t *Dst,
+                            std::size_t Count) {
+  const __m256 Scale = _mm256_set1_ps(65535.0f);
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    __m256i V = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(Src + I * 2)));
+    _mm256_storeu_ps(reinterpret_cast<float *>(Dst + I),
+                     _mm256_div_ps(_mm256_cvtepi32_ps(V), Scale));
+  }
+  decodeUnorm16SSE2(Src + I * 2, Dst + I, Count - I);
+}
+
+AVX2 void encodeUnorm16AVX2(const uint32_t *Src, uint8_t *Dst,
+                            std::size_t Count) {
+  const __m256 Zero = _mm256_setzero_ps(), One = _mm256_set1_ps(1.0f);
+  const __m256 Scale = _mm256_set1_ps(65535.0f), Half = _mm256_set1_ps(0.5f);
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    __m256 F = _mm256_loadu_ps(reinterpret_cast<const float *>(Src + I));
+    F = _mm256_min_ps(_mm256_max_ps(F, Zero), One);
+    __m256i V =
+        _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(F, Scale), Half));
+    V = _mm256_permute4x64_epi64(_mm256_packus_epi32(V, V), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(Dst + I * 2),
+                     _mm256_castsi256_si128(V));
+  }
+  encodeUnorm16SSE2(Src + I, Dst + I * 2, Count - I);
+}
+
+#undef AVX2
+
+#endif // __SSE2__
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+void decodeUnorm8NEON(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  const float32x4_t Scale = vdupq_n_f32(255.0f);
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    uint16x8_t V = vmovl_u8(vld1_u8(Src + I));
+    float32x4_t Low = vcvtq_f32_u32(vmovl_u16(vget_low_u16(V)));
+    float32x4_t High = vcvtq_f32_u32(vmovl_u16(vget_high_u16(V)));
+    vst1q_f32(reinterpret_cast<float *>(Dst + I), vdivq_f32(Low, Scale));
+    vst1q_f32(reinterpret_cast<float *>(Dst + I + 4), vdivq_f32(High, Scale));
+  }
+  decodeUnorm<uint8_t, 255>(Src + I, Dst + I, Count - I);
+}
+
+// Rounds a vector of floats to unorm values of Max the same way toUnorm
+// does. vmaxnmq takes the number for NaNs.
+uint32x4_t toUnormNEON(float32x4_t F, float Max) {
+  F = vminq_f32(vmaxnmq_f32(F, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+  F = vaddq_f32(vmulq_f32(F, vdupq_n_f32(Max)), vdupq_n_f32(0.5f));
+  return vcvtq_u32_f32(F);
+}
+
+void encodeUnorm8NEON(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  std::size_t I = 0;
+  for (; I + 8 <= Count; I += 8) {
+    uint32x4_t Low =
+        toUnormNEON(vld1q_f32(reinterpret_cast<const float *>(Src + I)), 255);
+    uint32x4_t High = toUnormNEON(
+        vld1q_f32(reinterpret_cast<const float *>(Src + I + 4)), 255);
+    vst1_u8(Dst + I,
+            vmovn_u16(vcombine_u16(vmovn_u32(Low), vmovn_u32(High))));
+  }
+  encodeUnorm<uint8_t, 255>(Src + I, Dst + I, Count - I);
+}
+
+void decodeUnorm16NEON(const uint8_t *Src, uint32_t *Dst, std::size_t Count) {
+  const float32x4_t Scale = vdupq_n_f32(65535.0f);
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    uint16x4_t V = vreinterpret_u16_u8(vld1_u8(Src + I * 2));
+    vst1q_f32(reinterpret_cast<float *>(Dst + I),
+              vdivq_f32(vcvtq_f32_u32(vmovl_u16(V)), Scale));
+  }
+  decodeUnorm<uint16_t, 65535>(Src + I * 2, Dst + I, Count - I);
+}
+
+void encodeUnorm16NEON(const uint32_t *Src, uint8_t *Dst, std::size_t Count) {
+  std::size_t I = 0;
+  for (; I + 4 <= Count; I += 4) {
+    uint32x4_t V = toUnormNEON(
+        vld1q_f32(reinterpret_cast<const float *>(Src + I)), 65535);
+    vst1_u8(Dst + I * 2, vreinterpret_u8_u16(vmovn_u32(V)));
+  }
+  encodeUnorm<uint16_t, 65535>(Src + I, Dst + I * 2, Count - I);
+}
+
+#endif // __ARM_NEON && __aarch64__
+
+// The codecs of the channel types, indexed by hsa_ext_image_channel_type_t.
+// The scalar codecs are replaced with the vector kernels the host supports
+// on first use.
+struct CodecTable {
+  ChannelTypeCodec Codecs[HSA_EXT_IMAGE_CHANNEL_TYPE_FLOAT + 1];
+
+  CodecTable()
+      : Codecs{{decodeSnorm<int8_t, 127>, encodeSnorm<int8_t, 127>},
+               {decodeSnorm<int16_t, 32767>, encodeSnorm<int16_t, 32767>},
+               {decodeUnorm<uint8_t, 255>, encodeUnorm<uint8_t, 255>},
+               {decodeUnorm<uint16_t, 65535>, encodeUnorm<uint16_t, 65535>},
+               {decodeUnorm24, encodeUnorm24},
+               {decodePacked<uint16_t, 5, 5, 5>,
+                encodePacked<uint16_t, 5, 5, 5>},
+               {decodePacked<uint16_t, 5, 6, 5>,
+                encodePacked<uint16_t, 5, 6, 5>},
+               {decodePacked<uint32_t, 10, 10, 10>,
+                encodePacked<uint32_t, 10, 10, 10>},
+               {decodeInteger<int8_t>, encodeInteger<int8_t>},
+               {decodeInteger<int16_t>, encodeInteger<int16_t>},
+               {decode32, encode32},
+               {decodeInteger<uint8_t>, encodeInteger<uint8_t>},
+               {decodeInteger<uint16_t>, encodeInteger<uint16_t>},
+               {decode32, encode32},
+               {decodeHalf, encodeHalf},
+               {decode32, encode32}} {
+    ChannelTypeCodec &Unorm8 = Codecs[HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT8];
+    ChannelTypeCodec &Unorm16 = Codecs[HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT16];
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      Unorm8 = {decodeUnorm8AVX2, encodeUnorm8AVX2};
+      Unorm16 = {decodeUnorm16AVX2, encodeUnorm16AVX2};
+    } else {
+      Unorm8 = {decodeUnorm8SSE2, encodeUnorm8SSE2};
+      Unorm16 = {decodeUnorm16SSE2, encodeUnorm16SSE2};
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    Unorm8 = {decodeUnorm8NEON, encodeUnorm8NEON};
+    Unorm16 = {decodeUnorm16NEON, encodeUnorm16NEON};
+#endif
+  }
+};
+
+const ChannelTypeCodec &codec(hsa_ext_image_channel_type_t Type) {
+  static const CodecTable Table;
+  return Table.Codecs[Type];
+}
+
+bool isIdentityOrder(hsa_ext_image_channel_order_t Order) {
+  return Order == HSA_EXT_IMAGE_CHANNEL_ORDER_RGBA ||
+         Order == HSA_EXT_IMAGE_CHANNEL_ORDER_SRGBA;
+}
+
+} // namespace
+
+std::size_t imageElementSize(const hsa_ext_image_format_t &Format) {
+  hsa_ext_image_channel_order_t Order = Format.channel_order;
+  hsa_ext_image_channel_type_t Type = Format.channel_type;
+
+  if (Order > HSA_EXT_IMAGE_CHANNEL_ORDER_DEPTH_STENCIL ||
+      Type > HSA_EXT_IMAGE_CHANNEL_TYPE_FLOAT)
+    return 0;
+
+  bool RGB = Order == HSA_EXT_IMAGE_CHANNEL_ORDER_RGB ||
+             Order == HSA_EXT_IMAGE_CHANNEL_ORDER_RGBX;
+  std::size_t Size = 0;
+  switch (Type) {
+  case HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_SHORT_555:
+  case HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_SHORT_565:
+    Size = RGB ? 2 : 0;
+    break;
+  case HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_SHORT_101010:
+    Size = RGB ? 4 : 0;
+    break;
+  case HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT24:
+    // The stencil shares the 32 bits with the depth.
+    Size = isDepth(Order) ? 4 : 0;
+    break;
+  default:
+    switch (Order) {
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_DEPTH:
+      if (Type == HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT16 ||
+          Type == HSA_EXT_IMAGE_CHANNEL_TYPE_FLOAT)
+        Size = ChannelTypeSizes[Type];
+      break;
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_DEPTH_STENCIL:
+      // The stencil is stored in the low bits of the second word.
+      if (Type == HSA_EXT_IMAGE_CHANNEL_TYPE_FLOAT)
+        Size = 8;
+      break;
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_BGRA:
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_ARGB:
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_ABGR:
+      if (ChannelTypeSizes[Type] == 1)
+        Size = 4;
+      break;
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_INTENSITY:
+    case HSA_EXT_IMAGE_CHANNEL_ORDER_LUMINANCE:
+      if (!isInteger(Type))
+        Size = ChannelTypeSizes[Type];
+      break;
+    default:
+      if (!isSRGB(Order) || Type == HSA_EXT_IMAGE_CHANNEL_TYPE_UNORM_INT8)
+        Size = ChannelOrders[Order].Count * ChannelTypeSizes[Type];
+      break;
+    }
+  }
+
+  // Drops the three channel formats.
+  if ((Size & (Size - 1)) != 0)
+    return 0;
+  return Size;
+}
+
+std::size_t imageElementSize(hsa_ext_image_geometry_t Geometry,
+                             const hsa_ext_image_format_t &Format) {
+  if (Geometry > HSA_EXT_IMAGE_GEOMETRY_2DADEPTH)
+    return 0;
+
+  bool DepthGeometry = Geometry == HSA_EXT_IMAGE_GEOMETRY_2DDEPTH ||
+                       Geometry == HSA_EXT_IMAGE_GEOMETRY_2DADEPTH;
+  if (DepthGeometry != isDepth(Format.channel_order))
+    return 0;
+
+  return imageElementSize(Format);
+}
+
+uint32_t imageFormatCapability(hsa_ext_image_geometry_t Geometry,
+                               const hsa_ext_image_format_t &Format) {
+  if (imageElementSize(Geometry, Format) == 0)
+    return HSA_EXT_IMAGE_CAPABILITY_NOT_SUPPORTED;
+
+  if (isSRGB(Format.channel_order))
+    return HSA_EXT_IMAGE_CAPABILITY_READ_ONLY |
+           HSA_EXT_IMAGE_CAPABILITY_ACCESS_INVARIANT_DATA_LAYOUT;
+
+  return HSA_EXT_IMAGE_CAPABILITY_READ_ONLY |
+         HSA_EXT_IMAGE_CAPABILITY_WRITE_ONLY |
+         HSA_EXT_IMAGE_CAPABILITY_READ_WRITE |
+         HSA_EXT_IMAGE_CAPABILITY_READ_MODIFY_WRITE |
+         HSA_EXT_IMAGE_CAPABILITY_ACCESS_INVARIANT_DATA_LAYOUT;
+}
+
+void decodeImageElements(const hsa_ext_image_format_t &Format, const void *Src,
+                         uint32_t *Access, std::size_t Count) {
+  const ChannelTypeCodec &Codec = codec(Format.channel_type);
+  const uint8_t *S = static_cast<const uint8_t *>(Src);
+
+  if (isPacked(Format.channel_type)) {
+    Codec.Decode(S, Access, Count);
+    return;
+  }
+
+  if (isIdentityOrder(Format.channel_order)) {
+    Codec.Decode(S, Access, Count * 4);
+  } else {
+    const int8_t *Sources = ChannelOrders[Format.channel_order].Sources;
+    unsigned Channels = channelCount(Format);
+    std::size_t ElementSize = Channels * channelSize(Format.channel_type);
+    uint32_t Alpha = accessType(Format.channel_type) == 0 ? FloatOne : 1;
+    uint32_t Defaults[4] = {0, 0, 0, Alpha};
+
+    uint32_t Values[BlockSize * 4];
+    for (std::size_t Done = 0; Done < Count;) {
+      std::size_t N = std::min(BlockSize, Count - Done);
+      Codec.Decode(S + Done * ElementSize, Values, N * Channels);
+      uint32_t *A = Access + Done * 4;
+      for (std::size_t I = 0; I < N; ++I, A += 4)
+        for (unsigned C = 0; C < 4; ++C)
+          A[C] = Sources[C] < 0 ? Defaults[C]
+                                : Values[I * Channels + Sources[C]];
+      Done += N;
+    }
+  }
+
+  if (isSRGB(Format.channel_order)) {
+    for (std::size_t I = 0; I < Count; ++I)
+      for (unsigned C = 0; C < 3; ++C)
+        Access[I * 4 + C] = asBits(fromSRGB(asFloat(Access[I * 4 + C])));
+  }
+}
+
+void encodeImageElements(const hsa_ext_image_format_t &Format,
+                         const uint32_t *Access, void *Dst,
+                         std::size_t Count) {
+  const ChannelTypeCodec &Codec = codec(Format.channel_type);
+  uint8_t *D = static_cast<uint8_t *>(Dst);
+  bool SRGB = isSRGB(Format.channel_order);
+
+  if (isPacked(Format.channel_type)) {
+    Codec.Encode(Access, D, Count);
+    return;
+  }
+
+  if (isIdentityOrder(Format.channel_order) && !SRGB) {
+    Codec.Encode(Access, D, Count * 4);
+    return;
+  }
+
+  const int8_t *Components = ChannelOrders[Format.channel_order].Components;
+  unsigned Channels = channelCount(Format);
+  std::size_t ElementSize = Channels * channelSize(Format.channel_type);
+
+  uint32_t Values[BlockSize * 4];
+  for (std::size_t Done = 0; Done < Count;) {
+    std::size_t N = std::min(BlockSize, Count - Done);
+    const uint32_t *A = Access + Done * 4;
+    for (std::size_t I = 0; I < N; ++I, A += 4) {
+      for (unsigned C = 0; C < Channels; ++C) {
+        int Component = Components[C];
+        uint32_t Value = Component < 0 ? 0 : A[Component];
+        if (SRGB && Component >= 0 && Component < 3)
+          Value = asBits(toSRGB(asFloat(Value)));
+        Values[I * Channels + C] = Value;
+      }
+    }
+    Codec.Encode(Values, D + Done * ElementSize, N * Channels);
+    Done += N;
+  }
+}
+
+bool canConvertImageElements(const hsa_ext_image_format_t &DstFormat,
+                             const hsa_ext_image_format_t &SrcFormat) {
+  return imageElementSize(DstFormat) != 0 &&
+         imageElementSize(SrcFormat) != 0 &&
+         accessType(DstFormat.channel_type) ==
+             accessType(SrcFormat.channel_type);
+}
+
+void convertImageElements(const hsa_ext_image_format_t &DstFormat, void *Dst,
+                          const hsa_ext_image_format_t &SrcFormat,
+                          const void *Src, std::size_t Count) {
+  std::size_t DstSize = imageElementSize(DstFormat);
+  std::size_t SrcSize = imageElementSize(SrcFormat);
+  uint8_t *D = static_cast<uint8_t *>(Dst);
+  const uint8_t *S = static_cast<const uint8_t *>(Src);
+
+  uint32_t Access[BlockSize * 4];
+  for (std::size_t Done = 0; Done < Count;) {
+    std::size_t N = std::min(BlockSize, Count - Done);
+    decodeImageElements(SrcFormat, S + Done * SrcSize, Access, N);
+    encodeImageElements(DstFormat, Access, D + Done * DstSize, N);
+    Done += N;
+  }
+}
+
+void encodeImageElement(const hsa_ext_image_format_t &Format, const void *Data,
+                        void *Element) {
+  uint32_t Access[4] = {0, 0, 0, 0};
+  std::memcpy(Access, Data,
+              (isDepth(Format.channel_order) ? 1 : 4) * sizeof(uint32_t));
+  encodeImageElements(Format, Access, Element, 1);
+}
+
+} // namespace phsa
@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Image element formats of the CPU images.
+ */
+
+#ifndef HSA_RUNTIME_IMAGEFORMAT_HH
+#define HSA_RUNTIME_IMAGEFORMAT_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hsa_ext_image.h"
+
+namespace phsa {
+
+// Returns the size of an image element of Format in bytes, or 0 in case
+// the format is not supported with Geometry. Only formats with power of
+// two sized elements are supported so a tile row is always a whole number
+// of 16 byte vectors.
+std::size_t imageElementSize(hsa_ext_image_geometry_t Geometry,
+                             const hsa_ext_image_format_t &Format);
+
+// Returns the element size of Format with any geometry, or 0 in case the
+// format is not supported at all.
+std::size_t imageElementSize(const hsa_ext_image_format_t &Format);
+
+// Returns the hsa_ext_image_capability_t mask of Format with Geometry.
+uint32_t imageFormatCapability(hsa_ext_image_geometry_t Geometry,
+                               const hsa_ext_image_format_t &Format);
+
+// The elements are converted through their access values: four 32-bit
+// values per element in r, g, b, a order, holding a float, an int32_t or
+// an uint32_t depending on the channel type as described for
+// hsa_ext_image_clear. The channels missing from the channel order read
+// as 0, except alpha which reads as 1.
+void decodeImageElements(const hsa_ext_image_format_t &Format, const void *Src,
+                         uint32_t *Access, std::size_t Count);
+void encodeImageElements(const hsa_ext_image_format_t &Format,
+                         const uint32_t *Access, void *Dst, std::size_t Count);
+
+// Returns true if the elements of SrcFormat can be converted to DstFormat,
+// that is, both are supported and have the same access type.
+bool canConvertImageElements(const hsa_ext_image_format_t &DstFormat,
+                             const hsa_ext_image_format_t &SrcFormat);
+
+// Converts Count elements of SrcFormat at Src to DstFormat at Dst.
+void convertImageElements(const hsa_ext_image_format_t &DstFormat, void *Dst,
+                          const hsa_ext_image_format_t &SrcFormat,
+                          const void *Src, std::size_t Count);
+
+// Encodes the clear value Data to the image element at Element. Data
+// holds the access values of the access components, as described for
+// hsa_ext_image_clear.
+void encodeImageElement(const hsa_ext_image_format_t &Format, const void *Data,
+                        void *Element);
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_IMAGEFORMAT_HH
@@ -26,6 +26,7 @@
 #include "common/Atomic.hh"
 #include "HSAObjectMapping.hh"
 #include "Signal.hh"
+#include "common/Timestamp.hh"
 
 namespace phsa {
 
@@ -63,6 +64,7 @@ public:
 
   virtual void store(hsa_signal_value_t Value, MemoryOrder MO) override {
     CurrentValue.store(Value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
   virtual hsa_signal_value_t
@@ -75,35 +77,45 @@ public:
 
   virtual hsa_signal_value_t exchange(hsa_signal_value_t Value,
                                       MemoryOrder MO) override {
-    return CurrentValue.exchange(Value, ToStdMemoryOrder(MO));
+    hsa_signal_value_t Old =
+        CurrentValue.exchange(Value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
+    return Old;
   }
 
   virtual hsa_signal_value_t compareExchange(hsa_signal_value_t Expected,
                                              hsa_signal_value_t Value,
                                              MemoryOrder MO) override {
-    return CurrentValue.compare_exchange_strong(
+    CurrentValue.compare_exchange_strong(
         Expected, Value, ToStdMemoryOrder(MO),
         ToStdMemoryOrder(Atomic::ToCompareExchangeFailure(MO)));
+    SignalEvents::notify();
+    return Expected;
   }
 
   virtual void add(hsa_signal_value_t value, MemoryOrder MO) override {
     CurrentValue.fetch_add(value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
   virtual void subtract(hsa_signal_value_t value, MemoryOrder MO) override {
     CurrentValue.fetch_sub(value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
   virtual void xor_(hsa_signal_value_t value, MemoryOrder MO) override {
     CurrentValue.fetch_xor(value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
   virtual void and_(hsa_signal_value_t value, MemoryOrder MO) override {
     CurrentValue.fetch_and(value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
   virtual void or_(hsa_signal_value_t value, MemoryOrder MO) override {
     CurrentValue.fetch_or(value, ToStdMemoryOrder(MO));
+    SignalEvents::notify();
   }
 
 private:
@@ -114,15 +126,13 @@ private:
                           std::chrono::high_resolution_clock::duration Timeout,
                           std::memory_order MemoryOrder) {
 
-    std::function<std::chrono::high_resolution_clock::time_point(void)> Now =
-        []() { return std::chrono::high_resolution_clock::now(); };
-    std::chrono::high_resolution_clock::time_point StartTime = Now();
+    uint64_t Deadline = Timestamp::deadline(Timeout);
 
     hsa_signal_value_t Value;
     do {
       Value = CurrentValue.load(MemoryOrder);
 
-      if (Now() - StartTime > Timeout)
+      if (Timestamp::now() > Deadline)
         break;
     } while (!Condition(Value));
 
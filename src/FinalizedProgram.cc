@@ -24,6 +24,9 @@
  */
 #include "FinalizedProgram.hh"
 
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <cstdlib>
 #include <libelf.h>
 
 namespace phsa {
@@ -31,6 +34,14 @@ namespace phsa {
 FinalizedProgram::FinalizedProgram(char *ElfBlob, size_t ElfSize, hsa_isa_t ISA,
                                    hsa_machine_model_t MM, hsa_profile_t P,
                                    hsa_default_float_rounding_mode_t RM)
+    : FinalizedProgram(std::shared_ptr<char>(ElfBlob,
+                                             std::default_delete<char[]>()),
+                       ElfSize, ISA, MM, P, RM) {}
+
+FinalizedProgram::FinalizedProgram(std::shared_ptr<char> ElfBlob,
+                                   size_t ElfSize, hsa_isa_t ISA,
+                                   hsa_machine_model_t MM, hsa_profile_t P,
+                                   hsa_default_float_rounding_mode_t RM)
     : BinaryFileName(""), ELFBlob(ElfBlob), ELFSize(ElfSize), IsValid(true),
       ISA(ISA), MachineModel(MM), Profile(P), DefaultRoundingMode(RM) {
 
@@ -40,7 +51,7 @@ FinalizedProgram::FinalizedProgram(char *ElfBlob, size_t ElfSize, hsa_isa_t ISA,
   Elf64_Shdr *SectionHeader = nullptr;
   Elf_Scn *Section = nullptr;
   Elf_Data *DataDesc = nullptr;
-  Elf *ELF = elf_memory(ElfBlob, ElfSize);
+  Elf *ELF = elf_memory(ELFBlob.get(), ElfSize);
 
   Elf64_Ehdr *EHdr = elf64_getehdr(ELF);
   Version = EHdr->e_version;
@@ -66,12 +77,15 @@ FinalizedProgram::FinalizedProgram(char *ElfBlob, size_t ElfSize, hsa_isa_t ISA,
     }
   }
   free(ELF);
+
+  for (const auto &Entry : FuncDescriptors)
+    DescriptorsByHash.insert(
+        {boost::hash_range(Entry.first.begin(), Entry.first.end()), &Entry});
 }
 
 FinalizedProgram::~FinalizedProgram() {
-  delete[](char *)ELFBlob;
-  for (auto I = symbol_begin(), End = symbol_end(); I != End; ++I) {
-    delete (*I);
+  for (Symbol *S : Symbols) {
+    delete S;
   }
 }
 
@@ -109,41 +123,59 @@ bool FinalizedProgram::loadAndCheckControlDirectives(
   return true;
 }
 
-Symbol *FinalizedProgram::findSymbol(std::string const &SymbolName) {
-  bool HasModule = SymbolName.find("::") != std::string::npos;
-  std::string ActualSymbolName = SymbolName;
-  // Replace "::":s with dots
-  size_t pos = 0;
-  while ((pos = ActualSymbolName.find("::", pos)) != std::string::npos) {
-    ActualSymbolName.replace(pos, 2, ".");
-    pos += 1;
+Symbol *FinalizedProgram::findSymbol(boost::string_ref SymbolName) {
+  {
+    std::lock_guard<std::mutex> L(SymbolLock);
+    if (Symbol *S = SymbolsByName.find(SymbolName))
+      return S;
+  }
+  std::lock_guard<std::mutex> L(OwnersLock);
+  for (Executable *Owner : Owners) {
+    // The executable adds the symbol to this program in case it was
+    // loaded lazily from it.
+    Owner->getSymbol(SymbolName);
+    std::lock_guard<std::mutex> SL(SymbolLock);
+    if (Symbol *S = SymbolsByName.find(SymbolName))
+      return S;
   }
+  return nullptr;
+}
 
-  // Remove all &:s except the first one
-  ActualSymbolName.erase(
-      std::remove(ActualSymbolName.begin() + 1, ActualSymbolName.end(), '&'),
-      ActualSymbolName.end());
+FinalizedProgram::symbol_iterator FinalizedProgram::symbol_begin() {
+  std::lock_guard<std::mutex> L(OwnersLock);
+  for (Executable *Owner : Owners)
+    Owner->loadSymbols();
+  return Symbols.begin();
+}
 
-  // If the module is specified, GCC prefixes the name with "gccbrig"
-  if (HasModule)
-    ActualSymbolName.insert(1, "gccbrig.");
+void FinalizedProgram::addExecutable(Executable &Owner) {
+  std::lock_guard<std::mutex> L(OwnersLock);
+  Owners.push_back(&Owner);
+}
 
-  for (auto I = symbol_begin(), End = symbol_end(); I != End; ++I) {
-    if ((*I)->Name == ActualSymbolName) {
-      return *I;
-    }
-  }
-  
-  return nullptr;
+void FinalizedProgram::removeExecutable(const Executable &Owner) {
+  std::lock_guard<std::mutex> L(OwnersLock);
+  auto Found = std::find(Owners.begin(), Owners.end(), &Owner);
+  if (Found != Owners.end())
+    Owners.erase(Found);
 }
 
-phsa_descriptor *
-FinalizedProgram::findDescriptor(std::string const &SymbolName) {
+bool FinalizedProgram::lazyLoading() {
+  static const bool Lazy = [] {
+    const char *Env = std::getenv("PHSA_LAZY_LOADING");
+    return Env != nullptr && std::string(Env) == "1";
+  }();
+  return Lazy;
+}
 
-  auto DescIter = FuncDescriptors.find(SymbolName);
-  if (DescIter != FuncDescriptors.end())
-    return (*DescIter).second;
-  else
-    return nullptr;
+phsa_descriptor *
+FinalizedProgram::findDescriptor(boost::string_ref SymbolName) {
+  auto Range = DescriptorsByHash.equal_range(
+      boost::hash_range(SymbolName.begin(), SymbolName.end()));
+  for (auto I = Range.first; I != Range.second; ++I) {
+    if (SymbolName == I->second->first)
+      return I->second->second;
+  }
+  return nullptr;
 }
 }
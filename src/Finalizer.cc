@@ -22,6 +22,12 @@
  */
 
 #include "Finalizer.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+
+#include "common/ThreadPool.hh"
 #include "HSAILProgram.hh"
 
 HSAReturnValue<hsa_ext_program_s>
@@ -39,3 +45,116 @@ void Finalizer::destroyProgram(hsa_ext_program_t Program) {
 void Finalizer::addModule(hsa_ext_program_t Program, hsa_ext_module_t Module) {
   phsa::HSAILProgram::fromHSAObject(Program)->addModule(Module);
 }
+
+std::vector<HSAReturnValue<hsa_code_object_s>>
+Finalizer::finalizePrograms(const std::vector<hsa_ext_program_t> &Programs,
+                            hsa_ext_control_directives_t ControlDirectives,
+                            hsa_isa_t ISA, const char *VendorCompilerOptions) {
+  std::vector<HSAReturnValue<hsa_code_object_s>> Results(Programs.size());
+
+  // A finalizer thread must neither wait for its own pool nor hold a
+  // reference to it, as it cannot join itself in case the reference is
+  // the last one.
+  if (isFinalizerThread()) {
+    for (size_t I = 0; I < Programs.size(); ++I)
+      Results[I] = finalizeProgram(Programs[I], ControlDirectives, ISA,
+                                   VendorCompilerOptions);
+    return Results;
+  }
+
+  std::shared_ptr<phsa::ThreadPool> Pool;
+  {
+    std::lock_guard<std::mutex> L(ThreadsLock);
+    Pool = currentThreads();
+  }
+
+  // The calling thread only waits so the asynchronous finalizations
+  // share the same concurrency limit.
+  std::mutex DoneLock;
+  std::condition_variable AllDone;
+  size_t Remaining = Programs.size();
+  for (size_t I = 0; I < Programs.size(); ++I) {
+    Pool->submit([&, I]() {
+      Results[I] = finalizeProgram(Programs[I], ControlDirectives, ISA,
+                                   VendorCompilerOptions);
+      std::lock_guard<std::mutex> L(DoneLock);
+      if (--Remaining == 0)
+        AllDone.notify_one();
+    });
+  }
+
+  std::unique_lock<std::mutex> L(DoneLock);
+  AllDone.wait(L, [&]() { return Remaining == 0; });
+  return Results;
+}
+
+void Finalizer::finalizeProgramAsync(
+    hsa_ext_program_t Program, hsa_ext_control_directives_t ControlDirectives,
+    hsa_isa_t ISA, std::string VendorCompilerOptions, FinalizeCallback Done) {
+  // Submitted under the lock so that no reference to the pool is held,
+  // which could otherwise be the last one in a finalizer thread.
+  std::lock_guard<std::mutex> L(ThreadsLock);
+  currentThreads()->submit([=]() {
+    Done(finalizeProgram(Program, ControlDirectives, ISA,
+                         VendorCompilerOptions.c_str()));
+  });
+}
+
+void Finalizer::shutDown() {
+  std::shared_ptr<phsa::ThreadPool> Pool;
+  std::vector<std::shared_ptr<phsa::ThreadPool>> Retired;
+  {
+    std::lock_guard<std::mutex> L(ThreadsLock);
+    Pool.swap(Threads);
+    Retired.swap(RetiredThreads);
+  }
+  // Runs the queued finalizations to completion before joining.
+  Pool.reset();
+  Retired.clear();
+}
+
+void Finalizer::setThreadCount(unsigned Count) {
+  if (Count == 0)
+    Count = std::max(1u, std::thread::hardware_concurrency());
+  std::shared_ptr<phsa::ThreadPool> Pool =
+      std::make_shared<phsa::ThreadPool>(Count);
+
+  std::vector<std::shared_ptr<phsa::ThreadPool>> Retired;
+  {
+    std::lock_guard<std::mutex> L(ThreadsLock);
+    if (Threads != nullptr)
+      RetiredThreads.push_back(std::move(Threads));
+    Threads = std::move(Pool);
+    // A pool cannot be joined from its own thread, so the release of the
+    // retired pools is left to a later call from outside of them.
+    bool InRetired = std::any_of(
+        RetiredThreads.begin(), RetiredThreads.end(),
+        [](const std::shared_ptr<phsa::ThreadPool> &P) {
+          return P->isPoolThread();
+        });
+    if (!InRetired)
+      Retired.swap(RetiredThreads);
+  }
+  // Joining drains the queued finalizations, which is done without the
+  // lock so that the callers of the new pool are not blocked.
+  Retired.clear();
+}
+
+const std::shared_ptr<phsa::ThreadPool> &Finalizer::currentThreads() {
+  if (Threads == nullptr) {
+    unsigned Count =
+        phsa::ThreadPool::threadCountFromEnvironment("PHSA_FINALIZER_THREADS");
+    Threads = std::make_shared<phsa::ThreadPool>(std::max(1u, Count));
+  }
+  return Threads;
+}
+
+bool Finalizer::isFinalizerThread() {
+  std::lock_guard<std::mutex> L(ThreadsLock);
+  if (Threads != nullptr && Threads->isPoolThread())
+    return true;
+  return std::any_of(RetiredThreads.begin(), RetiredThreads.end(),
+                     [](const std::shared_ptr<phsa::ThreadPool> &P) {
+                       return P->isPoolThread();
+                     });
+}
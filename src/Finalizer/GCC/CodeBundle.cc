@@ -0,0 +1,305 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Bundles of programs finalized ahead of time.
+ */
+
+#include "CodeBundle.hh"
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Brig.h"
+#include "HSAILProgram.hh"
+#include "ISA.hh"
+#include "common/Hash.hh"
+
+namespace phsa {
+
+namespace {
+
+const char Magic[8] = {'P', 'H', 'S', 'A', 'B', 'N', 'D', 'L'};
+const uint32_t FormatVersion = 1;
+const std::size_t EntryAlignment = 16;
+
+struct FileHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t EntryCount;
+  uint64_t SlotCount;
+  uint64_t IndexOffset;
+};
+
+struct EntryHeader {
+  uint64_t BRIGHashLow;
+  uint64_t BRIGHashHigh;
+  uint32_t Profile;
+  uint32_t MachineModel;
+  uint32_t RoundingMode;
+  uint32_t Reserved;
+  char ISA[64];
+  uint64_t Size;
+};
+
+// An empty slot has a zero EntryOffset, as no entry starts at the
+// beginning of the file.
+struct IndexSlot {
+  uint64_t KeyLow;
+  uint64_t KeyHigh;
+  uint64_t EntryOffset;
+};
+
+uint64_t low(unsigned __int128 Value) { return static_cast<uint64_t>(Value); }
+uint64_t high(unsigned __int128 Value) {
+  return static_cast<uint64_t>(Value >> 64);
+}
+
+std::size_t alignUp(std::size_t Value) {
+  return (Value + EntryAlignment - 1) & ~(EntryAlignment - 1);
+}
+
+std::mutex LoadedLock;
+std::vector<std::shared_ptr<CodeBundle>> Loaded;
+
+void loadFromEnvironment() {
+  static std::once_flag Once;
+  std::call_once(Once, []() {
+    const char *BundlesEnv = std::getenv("PHSA_CODE_BUNDLES");
+    if (BundlesEnv == nullptr)
+      return;
+    std::istringstream Paths(BundlesEnv);
+    std::string Path;
+    while (std::getline(Paths, Path, ':')) {
+      if (!Path.empty() && !CodeBundle::load(Path))
+        std::cerr << "phsa-finalizer: could not load the code bundle " << Path
+                  << "." << std::endl;
+    }
+  });
+}
+
+} // namespace
+
+unsigned __int128 CodeBundle::Tags::key() const {
+  ContentHash Hash;
+  Hash.add(ISA);
+  Hash.addValue(Profile);
+  Hash.addValue(MachineModel);
+  Hash.addValue(RoundingMode);
+  Hash.addValue(BRIGHash);
+  return Hash.value();
+}
+
+CodeBundle::~CodeBundle() {
+  munmap(const_cast<uint8_t *>(Data), Size);
+}
+
+unsigned __int128 CodeBundle::brigHash(HSAILProgram &Program) {
+  ContentHash Hash;
+  for (size_t i = 0; i < Program.moduleCount(); ++i) {
+    const BrigModuleHeader *Header =
+        (const BrigModuleHeader *)Program.module(i);
+    Hash.addValue(Header->byteCount);
+    Hash.add(Header, Header->byteCount);
+  }
+  return Hash.value();
+}
+
+CodeBundle::Tags CodeBundle::tagsOf(HSAILProgram &Program, hsa_isa_t ISA) {
+  return tagsOf(Program, ISA, brigHash(Program));
+}
+
+CodeBundle::Tags CodeBundle::tagsOf(HSAILProgram &Program, hsa_isa_t ISA,
+                                    unsigned __int128 BRIGHash) {
+  return {::ISA::fromHSAObject(ISA), Program.getProfile(),
+          Program.getMachineModel(), Program.getDefaultRoundingMode(),
+          BRIGHash};
+}
+
+std::shared_ptr<CodeBundle> CodeBundle::open(const std::string &Path) {
+  int Fd = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (Fd == -1)
+    return nullptr;
+  struct stat Stat;
+  void *Mapped = MAP_FAILED;
+  if (fstat(Fd, &Stat) == 0 && Stat.st_size > 0)
+    Mapped = mmap(nullptr, Stat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+  close(Fd);
+  if (Mapped == MAP_FAILED)
+    return nullptr;
+
+  std::shared_ptr<CodeBundle> Bundle(
+      new CodeBundle(static_cast<const uint8_t *>(Mapped), Stat.st_size));
+  if (!Bundle->isValid())
+    return nullptr;
+  return Bundle;
+}
+
+bool CodeBundle::isValid() const {
+  if (Size < sizeof(FileHeader))
+    return false;
+  const FileHeader *Header = reinterpret_cast<const FileHeader *>(Data);
+  if (std::memcmp(Header->Magic, Magic, sizeof(Magic)) != 0 ||
+      Header->Version != FormatVersion || Header->SlotCount == 0 ||
+      (Header->SlotCount & (Header->SlotCount - 1)) != 0 ||
+      Header->IndexOffset % alignof(IndexSlot) != 0)
+    return false;
+  return Header->IndexOffset <= Size &&
+         Header->SlotCount <=
+             (Size - Header->IndexOffset) / sizeof(IndexSlot);
+}
+
+const uint8_t *CodeBundle::find(const Tags &T, std::size_t &EntrySize) const {
+  const FileHeader *Header = reinterpret_cast<const FileHeader *>(Data);
+  const IndexSlot *Slots =
+      reinterpret_cast<const IndexSlot *>(Data + Header->IndexOffset);
+  unsigned __int128 Key = T.key();
+  uint64_t Mask = Header->SlotCount - 1;
+
+  for (uint64_t Probe = 0; Probe < Header->SlotCount; ++Probe) {
+    const IndexSlot &Slot = Slots[(low(Key) + Probe) & Mask];
+    if (Slot.EntryOffset == 0)
+      return nullptr;
+    if (Slot.KeyLow != low(Key) || Slot.KeyHigh != high(Key))
+      continue;
+    if (Size < sizeof(EntryHeader) ||
+        Slot.EntryOffset > Size - sizeof(EntryHeader))
+      return nullptr;
+
+    const EntryHeader *E =
+        reinterpret_cast<const EntryHeader *>(Data + Slot.EntryOffset);
+    const uint8_t *CodeObject = Data + Slot.EntryOffset + sizeof(EntryHeader);
+    if (E->Size > static_cast<uint64_t>(Data + Size - CodeObject))
+      return nullptr;
+    // The key is a hash, so confirm the tags.
+    if (E->BRIGHashLow != low(T.BRIGHash) ||
+        E->BRIGHashHigh != high(T.BRIGHash) ||
+        E->Profile != static_cast<uint32_t>(T.Profile) ||
+        E->MachineModel != static_cast<uint32_t>(T.MachineModel) ||
+        E->RoundingMode != static_cast<uint32_t>(T.RoundingMode) ||
+        strncmp(E->ISA, T.ISA.c_str(), sizeof(E->ISA)) != 0)
+      continue;
+    EntrySize = E->Size;
+    return CodeObject;
+  }
+  return nullptr;
+}
+
+bool CodeBundle::write(const std::string &Path,
+                       const std::vector<Entry> &Entries) {
+  std::string Contents(sizeof(FileHeader), '\0');
+  std::vector<std::pair<unsigned __int128, uint64_t>> Offsets;
+
+  for (const Entry &E : Entries) {
+    if (E.EntryTags.ISA.size() >= sizeof(EntryHeader::ISA))
+      return false;
+    EntryHeader Header;
+    std::memset(&Header, 0, sizeof(Header));
+    Header.BRIGHashLow = low(E.EntryTags.BRIGHash);
+    Header.BRIGHashHigh = high(E.EntryTags.BRIGHash);
+    Header.Profile = E.EntryTags.Profile;
+    Header.MachineModel = E.EntryTags.MachineModel;
+    Header.RoundingMode = E.EntryTags.RoundingMode;
+    std::memcpy(Header.ISA, E.EntryTags.ISA.c_str(), E.EntryTags.ISA.size());
+    Header.Size = E.CodeObject.size();
+
+    Contents.resize(alignUp(Contents.size()), '\0');
+    Offsets.push_back({E.EntryTags.key(), Contents.size()});
+    Contents.append(reinterpret_cast<const char *>(&Header), sizeof(Header));
+    Contents.append(reinterpret_cast<const char *>(E.CodeObject.data()),
+                    E.CodeObject.size());
+  }
+
+  // At most half full to keep the probe sequences short.
+  uint64_t SlotCount = 1;
+  while (SlotCount < 2 * Offsets.size())
+    SlotCount *= 2;
+  std::vector<IndexSlot> Slots(SlotCount, IndexSlot{0, 0, 0});
+  for (const auto &Offset : Offsets) {
+    uint64_t Slot = low(Offset.first) & (SlotCount - 1);
+    while (Slots[Slot].EntryOffset != 0)
+      Slot = (Slot + 1) & (SlotCount - 1);
+    Slots[Slot] = {low(Offset.first), high(Offset.first), Offset.second};
+  }
+
+  FileHeader Header;
+  std::memcpy(Header.Magic, Magic, sizeof(Magic));
+  Header.Version = FormatVersion;
+  Header.EntryCount = Entries.size();
+  Header.SlotCount = SlotCount;
+  Contents.resize(alignUp(Contents.size()), '\0');
+  Header.IndexOffset = Contents.size();
+  std::memcpy(&Contents[0], &Header, sizeof(Header));
+  Contents.append(reinterpret_cast<const char *>(Slots.data()),
+                  Slots.size() * sizeof(IndexSlot));
+
+  // Written aside and renamed in place so that processes mapping the
+  // bundle never see it partially written. The temporary name is unique
+  // also between the threads of a process writing the same bundle.
+  std::string TempPath =
+      boost::filesystem::unique_path(Path + ".tmp-%%%%%%%%").string();
+  {
+    std::ofstream Out(TempPath, std::ofstream::binary);
+    if (!Out.write(Contents.data(), Contents.size())) {
+      std::remove(TempPath.c_str());
+      return false;
+    }
+  }
+  if (std::rename(TempPath.c_str(), Path.c_str()) != 0) {
+    std::remove(TempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool CodeBundle::load(const std::string &Path) {
+  std::shared_ptr<CodeBundle> Bundle = open(Path);
+  if (Bundle == nullptr)
+    return false;
+  std::lock_guard<std::mutex> L(LoadedLock);
+  Loaded.push_back(Bundle);
+  return true;
+}
+
+bool CodeBundle::anyLoaded() {
+  loadFromEnvironment();
+  std::lock_guard<std::mutex> L(LoadedLock);
+  return !Loaded.empty();
+}
+
+const uint8_t *CodeBundle::findLoaded(const Tags &T, std::size_t &Size) {
+  loadFromEnvironment();
+  std::lock_guard<std::mutex> L(LoadedLock);
+  for (const std::shared_ptr<CodeBundle> &Bundle : Loaded) {
+    if (const uint8_t *CodeObject = Bundle->find(T, Size))
+      return CodeObject;
+  }
+  return nullptr;
+}
+
+} // namespace phsa
@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Bundles of programs finalized ahead of time.
+ */
+
+#ifndef HSA_RUNTIME_CODEBUNDLE_HH
+#define HSA_RUNTIME_CODEBUNDLE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hsa.h"
+
+namespace phsa {
+
+class HSAILProgram;
+
+// A file of serialized code objects, each tagged with the program it was
+// finalized from, so that programs can be shipped finalized ahead of
+// time. The file is mapped to memory and the code objects are found with
+// an open addressing hash index stored at the end of the file.
+//
+// Bundles are loaded from the colon separated list of files in
+// PHSA_CODE_BUNDLES, or with load(). The finalizer returns the code
+// objects found in them without compiling.
+class CodeBundle {
+public:
+  // Identifies the program a code object was finalized from.
+  struct Tags {
+    std::string ISA;
+    hsa_profile_t Profile;
+    hsa_machine_model_t MachineModel;
+    hsa_default_float_rounding_mode_t RoundingMode;
+    // A hash of the BRIG modules of the program.
+    unsigned __int128 BRIGHash;
+
+    unsigned __int128 key() const;
+  };
+
+  struct Entry {
+    Tags EntryTags;
+    // The code object serialized with FinalizedProgram::serialize().
+    std::vector<uint8_t> CodeObject;
+  };
+
+  ~CodeBundle();
+
+  CodeBundle(CodeBundle const &) = delete;
+  CodeBundle &operator=(CodeBundle const &) = delete;
+
+  // A hash of the BRIG modules of the program, also usable as a part of
+  // other keys of the program to avoid hashing the modules again.
+  static unsigned __int128 brigHash(HSAILProgram &Program);
+
+  static Tags tagsOf(HSAILProgram &Program, hsa_isa_t ISA);
+  static Tags tagsOf(HSAILProgram &Program, hsa_isa_t ISA,
+                     unsigned __int128 BRIGHash);
+
+  // Maps the bundle at Path. Returns nullptr in case it could not be read
+  // or is not a valid bundle.
+  static std::shared_ptr<CodeBundle> open(const std::string &Path);
+
+  // Writes the entries as a bundle to Path.
+  static bool write(const std::string &Path,
+                    const std::vector<Entry> &Entries);
+
+  // Returns the serialized code object for the tags, or nullptr if the
+  // bundle has none.
+  const uint8_t *find(const Tags &T, std::size_t &Size) const;
+
+  // Adds the bundle at Path to the ones searched by findLoaded().
+  static bool load(const std::string &Path);
+
+  // Returns true in case any bundles are loaded, so the programs need to
+  // be looked up from them.
+  static bool anyLoaded();
+
+  // Searches the loaded bundles for a code object. The code object stays
+  // mapped as long as the runtime.
+  static const uint8_t *findLoaded(const Tags &T, std::size_t &Size);
+
+private:
+  CodeBundle(const uint8_t *Data, std::size_t Size)
+      : Data(Data), Size(Size) {}
+
+  bool isValid() const;
+
+  const uint8_t *Data;
+  std::size_t Size;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_CODEBUNDLE_HH
@@ -0,0 +1,323 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A persistent compile server for the GCC finalizer.
+ */
+
+#include "CompileServer.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common/Hash.hh"
+#include "common/ThreadPool.hh"
+
+namespace phsa {
+
+namespace {
+
+const uint32_t ProtocolVersion = 2;
+
+// Protects against allocating memory based on garbage lengths.
+const uint64_t MaxMessageBytes = 1ull << 30;
+const uint32_t MaxModules = 4096;
+
+const size_t DefaultMaxCompiledSize = 256 * 1024 * 1024;
+
+// How long a client waits for an unresponsive server in case no
+// compilation timeout is set.
+const unsigned DefaultClientTimeoutMs = 120 * 1000;
+
+bool sendAll(int Fd, const void *Data, size_t Size) {
+  const char *Bytes = static_cast<const char *>(Data);
+  while (Size > 0) {
+    ssize_t Sent = send(Fd, Bytes, Size, MSG_NOSIGNAL);
+    if (Sent < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Bytes += Sent;
+    Size -= Sent;
+  }
+  return true;
+}
+
+bool receiveAll(int Fd, void *Data, size_t Size) {
+  char *Bytes = static_cast<char *>(Data);
+  while (Size > 0) {
+    ssize_t Received = recv(Fd, Bytes, Size, 0);
+    if (Received < 0 && errno == EINTR)
+      continue;
+    if (Received <= 0)
+      return false;
+    Bytes += Received;
+    Size -= Received;
+  }
+  return true;
+}
+
+// The messages are built to a buffer and sent at once. Both ends run on
+// the same host, so the values are in the native byte order.
+template <typename T> void putValue(std::string &Message, T Value) {
+  Message.append(reinterpret_cast<const char *>(&Value), sizeof(Value));
+}
+
+void putBytes(std::string &Message, const void *Data, uint64_t Size) {
+  putValue(Message, Size);
+  Message.append(static_cast<const char *>(Data), Size);
+}
+
+void putString(std::string &Message, const std::string &String) {
+  putBytes(Message, String.data(), String.size());
+}
+
+template <typename T> bool getValue(int Fd, T &Value) {
+  return receiveAll(Fd, &Value, sizeof(Value));
+}
+
+bool getString(int Fd, std::string &String) {
+  uint64_t Size;
+  if (!getValue(Fd, Size) || Size > MaxMessageBytes)
+    return false;
+  String.resize(Size);
+  return Size == 0 || receiveAll(Fd, &String[0], Size);
+}
+
+bool socketAddress(const std::string &Path, sockaddr_un &Address) {
+  if (Path.empty() || Path.size() >= sizeof(Address.sun_path))
+    return false;
+  std::memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  std::memcpy(Address.sun_path, Path.c_str(), Path.size() + 1);
+  return true;
+}
+
+} // namespace
+
+CompileServer::CompileServer(std::string SocketPath, unsigned ThreadCount)
+    : SocketPath(SocketPath), ThreadCount(std::max(1u, ThreadCount)) {
+  const char *SizeEnv = std::getenv("PHSA_COMPILER_SERVER_MEMORY");
+  MaxCompiledSize = SizeEnv != nullptr ? std::strtoull(SizeEnv, nullptr, 10)
+                                       : DefaultMaxCompiledSize;
+}
+
+CompileServer::~CompileServer() { stop(); }
+
+bool CompileServer::start() {
+  sockaddr_un Address;
+  if (!socketAddress(SocketPath, Address))
+    return false;
+
+  ListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (ListenFd == -1)
+    return false;
+
+  // Replace the socket of a server that did not exit cleanly. Only the
+  // owner may connect, which is restricted before listening so no
+  // connection can be made in between.
+  unlink(SocketPath.c_str());
+  if (bind(ListenFd, reinterpret_cast<sockaddr *>(&Address),
+           sizeof(Address)) != 0 ||
+      chmod(SocketPath.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      listen(ListenFd, SOMAXCONN) != 0) {
+    close(ListenFd);
+    ListenFd = -1;
+    return false;
+  }
+
+  Workers.reset(new ThreadPool(ThreadCount));
+  Acceptor = std::thread(&CompileServer::acceptConnections, this);
+  return true;
+}
+
+void CompileServer::stop() {
+  if (ListenFd == -1)
+    return;
+  // Wakes up the acceptor blocked in accept().
+  shutdown(ListenFd, SHUT_RDWR);
+  Acceptor.join();
+  close(ListenFd);
+  ListenFd = -1;
+  unlink(SocketPath.c_str());
+  // Finishes the accepted requests.
+  Workers.reset();
+}
+
+void CompileServer::acceptConnections() {
+  while (true) {
+    int Connection = accept4(ListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (Connection == -1) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+    // Compiling runs programs as the user of the server, so other users
+    // are not served even in case they can reach the socket.
+    ucred Peer;
+    socklen_t PeerSize = sizeof(Peer);
+    if (getsockopt(Connection, SOL_SOCKET, SO_PEERCRED, &Peer, &PeerSize) !=
+            0 ||
+        Peer.uid != geteuid()) {
+      close(Connection);
+      continue;
+    }
+    Workers->submit([this, Connection]() {
+      serve(Connection);
+      close(Connection);
+    });
+  }
+}
+
+void CompileServer::serve(int Connection) {
+  uint32_t Version, ModuleCount;
+  std::string VendorOptions;
+  if (!getValue(Connection, Version) || Version != ProtocolVersion ||
+      !getString(Connection, VendorOptions) ||
+      !getValue(Connection, ModuleCount) || ModuleCount == 0 ||
+      ModuleCount > MaxModules)
+    return;
+
+  std::vector<std::string> ModuleData(ModuleCount);
+  std::vector<GCCFinalizer::BRIGModule> Modules;
+  uint64_t ReceivedBytes = 0;
+  for (std::string &Data : ModuleData) {
+    if (!getString(Connection, Data) ||
+        (ReceivedBytes += Data.size()) > MaxMessageBytes)
+      return;
+    Modules.push_back({Data.data(), Data.size()});
+  }
+
+  // The compiler and the flags are the ones of the server, so the key is
+  // computed here from what is actually compiled.
+  std::string CompilerBinary, InputFlags, CompileFlags;
+  std::string Diagnostics;
+  bool Configured = GCCFinalizer::compilerConfiguration(
+      "gccbrig", VendorOptions.c_str(), CompilerBinary, InputFlags,
+      CompileFlags);
+  ContentHash Hash;
+  for (const std::string &Data : ModuleData)
+    Hash.add(Data);
+  Hash.add(CompilerBinary).add(InputFlags).add(CompileFlags);
+  std::string Key = Hash.hex();
+
+  GCCFinalizer::FinalizedBinary Binary;
+  bool Succeeded = false;
+  if (!Configured) {
+    Diagnostics += "phsa-compile-server: the compiler was not found.\n";
+  } else {
+    std::lock_guard<std::mutex> L(CompiledLock);
+    auto Known = Compiled.find(Key);
+    if (Known != Compiled.end()) {
+      Binary = Known->second;
+      Succeeded = true;
+    }
+  }
+  if (Configured && !Succeeded) {
+    Succeeded = GCCFinalizer::compileBinary(CompilerBinary, Modules,
+                                            InputFlags, CompileFlags, Binary,
+                                            Diagnostics);
+    if (Succeeded)
+      remember(Key, Binary);
+  }
+
+  std::string Response;
+  putValue(Response, static_cast<uint8_t>(Succeeded));
+  putString(Response, Diagnostics);
+  putBytes(Response, Binary.ELFBlob.get(), Succeeded ? Binary.ELFSize : 0);
+  sendAll(Connection, Response.data(), Response.size());
+}
+
+void CompileServer::remember(const std::string &Key,
+                             const GCCFinalizer::FinalizedBinary &Binary) {
+  std::lock_guard<std::mutex> L(CompiledLock);
+  if (!Compiled.insert({Key, Binary}).second)
+    return;
+  CompiledOrder.push_back(Key);
+  CompiledSize += Binary.ELFSize;
+  while (CompiledSize > MaxCompiledSize && !CompiledOrder.empty()) {
+    auto Oldest = Compiled.find(CompiledOrder.front());
+    CompiledSize -= Oldest->second.ELFSize;
+    Compiled.erase(Oldest);
+    CompiledOrder.pop_front();
+  }
+}
+
+bool CompileServer::compile(const std::string &SocketPath, const Request &R,
+                            unsigned TimeoutMs,
+                            GCCFinalizer::FinalizedBinary &Binary,
+                            bool &Compiled, std::string &Diagnostics) {
+  sockaddr_un Address;
+  if (!socketAddress(SocketPath, Address))
+    return false;
+  int Fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (Fd == -1)
+    return false;
+
+  // A stopped or wedged server makes the connect, the sends or the
+  // receives time out, after which the caller compiles by itself.
+  if (TimeoutMs == 0)
+    TimeoutMs = DefaultClientTimeoutMs;
+  timeval Timeout;
+  Timeout.tv_sec = TimeoutMs / 1000;
+  Timeout.tv_usec = (TimeoutMs % 1000) * 1000;
+  bool Connected =
+      setsockopt(Fd, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout)) == 0 &&
+      setsockopt(Fd, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout)) == 0 &&
+      connect(Fd, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) == 0;
+  if (!Connected) {
+    close(Fd);
+    return false;
+  }
+
+  std::string Message;
+  putValue(Message, ProtocolVersion);
+  putString(Message, R.VendorOptions);
+  putValue(Message, static_cast<uint32_t>(R.Modules.size()));
+  for (const GCCFinalizer::BRIGModule &Module : R.Modules)
+    putBytes(Message, Module.Data, Module.Size);
+
+  uint8_t Succeeded;
+  std::string Errors, ELF;
+  bool Served = sendAll(Fd, Message.data(), Message.size()) &&
+                getValue(Fd, Succeeded) && getString(Fd, Errors) &&
+                getString(Fd, ELF);
+  close(Fd);
+  if (!Served)
+    return false;
+
+  Compiled = Succeeded != 0 && !ELF.empty();
+  Diagnostics += Errors;
+  if (Compiled) {
+    char *Blob = new char[ELF.size()];
+    std::memcpy(Blob, ELF.data(), ELF.size());
+    Binary.ELFBlob.reset(Blob, std::default_delete<char[]>());
+    Binary.ELFSize = ELF.size();
+  }
+  return true;
+}
+
+} // namespace phsa
@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A persistent compile server for the GCC finalizer.
+ */
+
+#ifndef HSA_RUNTIME_COMPILESERVER_HH
+#define HSA_RUNTIME_COMPILESERVER_HH
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "GCCFinalizer.hh"
+
+namespace phsa {
+
+class ThreadPool;
+
+// Compiles BRIG for the finalizers of other processes that connect to it
+// through a Unix domain socket. The finalizers use the server listening
+// at PHSA_COMPILER_SERVER in case there is one, and compile by themselves
+// otherwise. Requests are served concurrently, and the binaries are kept
+// in memory so a program finalized by one process is not recompiled for
+// the next one. The server can also run inside the process that uses it.
+// The binaries are compiled with the compiler and the flags configured in
+// the environment of the server, and only processes of the same user are
+// served.
+class CompileServer {
+public:
+  struct Request {
+    // The vendor compiler options given to the finalizer. Only the ones
+    // the finalizer recognizes affect the compilation.
+    std::string VendorOptions;
+    std::vector<GCCFinalizer::BRIGModule> Modules;
+  };
+
+  CompileServer(std::string SocketPath, unsigned ThreadCount);
+  ~CompileServer();
+
+  CompileServer(CompileServer const &) = delete;
+  CompileServer &operator=(CompileServer const &) = delete;
+
+  // Starts serving the socket in background threads. Returns false in
+  // case the socket could not be created.
+  bool start();
+
+  // Stops accepting connections and waits for the accepted requests to be
+  // served.
+  void stop();
+
+  // Sends the request to the server listening at SocketPath. Returns
+  // false in case the server could not be reached or did not respond
+  // within TimeoutMs milliseconds (two minutes in case zero), in which
+  // case the caller should compile by itself. Otherwise Compiled tells
+  // whether the compilation succeeded and Diagnostics gets its error
+  // messages.
+  static bool compile(const std::string &SocketPath, const Request &R,
+                      unsigned TimeoutMs,
+                      GCCFinalizer::FinalizedBinary &Binary, bool &Compiled,
+                      std::string &Diagnostics);
+
+private:
+  void acceptConnections();
+  void serve(int Connection);
+  void remember(const std::string &Key,
+                const GCCFinalizer::FinalizedBinary &Binary);
+
+  std::string SocketPath;
+  unsigned ThreadCount;
+  int ListenFd = -1;
+  std::unique_ptr<ThreadPool> Workers;
+  std::thread Acceptor;
+
+  // The binaries compiled by this server, by finalization key. The oldest
+  // ones are forgotten first once MaxCompiledSize is exceeded.
+  std::unordered_map<std::string, GCCFinalizer::FinalizedBinary> Compiled;
+  std::deque<std::string> CompiledOrder;
+  size_t CompiledSize = 0;
+  size_t MaxCompiledSize;
+  std::mutex CompiledLock;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_COMPILESERVER_HH
@@ -24,39 +24,94 @@
  */
 
 #include <boost/filesystem.hpp>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <link.h>
 #include <unistd.h>
 #include "DLFinalizedProgram.hh"
 #include "common/Debug.hh"
+#include "common/Hash.hh"
+#include "common/MemFile.hh"
 #include "ISA.hh"
 
+#ifdef PHSA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 namespace phsa {
 
+namespace {
+
+// The layout of a serialized code object. The header is followed by the
+// ELF binary, possibly compressed, at a cache line aligned offset.
+const char SerializedMagic[8] = {'P', 'H', 'S', 'A', 'C', 'O', 'D', 'E'};
+const uint32_t SerializedVersion = 1;
+const std::size_t SerializedPayloadOffset = 192;
+
+struct SerializedHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t HeaderSize;
+  uint32_t Compression;
+  uint32_t Profile;
+  uint32_t MachineModel;
+  uint32_t RoundingMode;
+  // The name of the ISA, as the handles are not stable across processes.
+  char ISA[64];
+  uint64_t PayloadOffset;
+  uint64_t PayloadSize;
+  uint64_t ELFSize;
+  uint64_t PayloadChecksum;
+  // Covers the fields above.
+  uint64_t HeaderChecksum;
+};
+
+static_assert(sizeof(SerializedHeader) <= SerializedPayloadOffset,
+              "The serialized header overlaps the payload.");
+
+} // namespace
+
 DLFinalizedProgram::DLFinalizedProgram(char *ElfBlob, size_t ElfSize,
                                        hsa_isa_t ISA, hsa_machine_model_t MM,
                                        hsa_profile_t P,
                                        hsa_default_float_rounding_mode_t RM)
-    : FinalizedProgram(ElfBlob, ElfSize, ISA, MM, P, RM), Dlhandle(nullptr) {}
+    : FinalizedProgram(ElfBlob, ElfSize, ISA, MM, P, RM), Dlhandle(nullptr),
+      LoadBase(0), BinaryFd(-1), TempBinFile(false), Users(0),
+      Original(nullptr) {}
+
+DLFinalizedProgram::DLFinalizedProgram(std::shared_ptr<char> ElfBlob,
+                                       size_t ElfSize, hsa_isa_t ISA,
+                                       hsa_machine_model_t MM, hsa_profile_t P,
+                                       hsa_default_float_rounding_mode_t RM)
+    : FinalizedProgram(ElfBlob, ElfSize, ISA, MM, P, RM), Dlhandle(nullptr),
+      LoadBase(0), BinaryFd(-1), TempBinFile(false), Users(0),
+      Original(nullptr) {}
 
 DLFinalizedProgram::~DLFinalizedProgram() {
-  if (Dlhandle != nullptr)
-    dlclose(Dlhandle);
+  if (void *Handle = Dlhandle.load(std::memory_order_relaxed))
+    dlclose(Handle);
   deregisterObject(this->toHSAObject());
 
-  if (!phsa::IsDebugMode()) {
+  if (BinaryFd != -1)
+    close(BinaryFd);
+
+  if (TempBinFile && !phsa::IsDebugMode()) {
     boost::filesystem::path TempF(BinaryFileName);
     TempF.remove_filename();
     boost::filesystem::remove_all(TempF);
   }
 }
 
-void DLFinalizedProgram::defineGlobalSymbolAddress(std::string SymbolName,
-                                                   uint64_t Addr) {
+char **DLFinalizedProgram::hostDefinitionSlot(std::string SymbolName) {
 
-  dlhandle();
+  void *Handle = dlhandle();
+  if (Handle == nullptr)
+    return nullptr;
 
   // GCC mangling does not contain & characters
   if (SymbolName.at(0) == '&')
@@ -65,39 +120,135 @@ void DLFinalizedProgram::defineGlobalSymbolAddress(std::string SymbolName,
   std::string HostDefSymName =
       std::string(PHSA_HOST_DEF_PTR_PREFIX) + SymbolName;
 
-  void *SymbolAddress = dlsym(Dlhandle, HostDefSymName.c_str());
-  char *Error = dlerror();
-  if (Error != NULL) {
+  dlerror();
+  void *SymbolAddress = dlsym(Handle, HostDefSymName.c_str());
+  if (dlerror() != NULL)
+    return nullptr;
+  return static_cast<char **>(SymbolAddress);
+}
+
+void DLFinalizedProgram::defineGlobalSymbolAddress(std::string SymbolName,
+                                                   uint64_t Addr) {
+
+  char **Slot = hostDefinitionSlot(SymbolName);
+  if (Slot == nullptr) {
     // Whole program optimizations might have removed the host def
     // in case it was used by a function not called by a kernel.
     // Exit silently here, in case it was needed by a function,
     // the actual error should occur already at when loading the .so.
     return;
   }
-  *(char **)SymbolAddress = (char *)Addr;
+  *Slot = (char *)Addr;
+}
+
+void DLFinalizedProgram::useFor(const SymbolAddressIndex &Definitions) {
+  for (auto &D : Definitions)
+    defineGlobalSymbolAddress(D.first, D.second);
+  HostDefinitions = Definitions;
+  Users = 1;
+}
+
+FinalizedProgram *
+DLFinalizedProgram::acquire(const SymbolAddressIndex &Definitions) {
+  if (Original != nullptr)
+    return Original->acquire(Definitions);
+
+  // Only the definitions the binary refers to can conflict.
+  SymbolAddressIndex Used;
+  for (auto &D : Definitions) {
+    if (hostDefinitionSlot(D.first) != nullptr)
+      Used.insert(D);
+  }
+
+  std::lock_guard<std::mutex> L(InstanceLock);
+  if (Users == 0) {
+    useFor(Used);
+    return this;
+  }
+  if (HostDefinitions == Used) {
+    ++Users;
+    return this;
+  }
+
+  DLFinalizedProgram *Idle = nullptr;
+  for (auto &I : Instances) {
+    if (I->Users > 0 && I->HostDefinitions == Used) {
+      ++I->Users;
+      return I.get();
+    }
+    if (I->Users == 0)
+      Idle = I.get();
+  }
+
+  if (Idle == nullptr) {
+    std::unique_ptr<DLFinalizedProgram> Copy(new DLFinalizedProgram(
+        sharedElfBlob(), elfSize(), ISA, MachineModel, Profile,
+        DefaultRoundingMode));
+    // The copies are not code objects of their own.
+    deregisterObject(Copy->toHSAObject());
+    if (!Copy->createBinaryImage() || Copy->dlhandle() == nullptr)
+      return nullptr;
+    Copy->Original = this;
+    Idle = Copy.get();
+    Instances.push_back(std::move(Copy));
+  }
+  Idle->useFor(Used);
+  return Idle;
+}
+
+void DLFinalizedProgram::release() {
+  DLFinalizedProgram *Owner = Original != nullptr ? Original : this;
+  std::lock_guard<std::mutex> L(Owner->InstanceLock);
+  assert(Users > 0);
+  --Users;
 }
 
 void *DLFinalizedProgram::dlhandle() {
 
-  if (Dlhandle != nullptr)
-    return Dlhandle;
+  void *Handle = Dlhandle.load(std::memory_order_acquire);
+  if (Handle != nullptr)
+    return Handle;
+
+  // The executables sharing the program may look up its symbols
+  // concurrently. LoadBase is set before the handle is published.
+  std::lock_guard<std::mutex> L(DlopenLock);
+  Handle = Dlhandle.load(std::memory_order_relaxed);
+  if (Handle != nullptr)
+    return Handle;
   assert(BinaryFileName != "");
   dlerror();
-  Dlhandle = dlopen(BinaryFileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+  // The functions are bound on their first call when loading lazily.
+  Handle = dlopen(BinaryFileName.c_str(),
+                  (lazyLoading() ? RTLD_LAZY : RTLD_NOW) | RTLD_LOCAL);
   char *DlErrorStr = dlerror();
   if (DlErrorStr != nullptr) {
     std::cerr << "dlopen() error: " << DlErrorStr << std::endl;
+    if (Handle != nullptr)
+      dlclose(Handle);
     return nullptr;
   }
-  return Dlhandle;
+  struct link_map *LinkMap = nullptr;
+  if (dlinfo(Handle, RTLD_DI_LINKMAP, &LinkMap) == 0 && LinkMap != nullptr)
+    LoadBase = LinkMap->l_addr;
+  Dlhandle.store(Handle, std::memory_order_release);
+  return Handle;
 }
 
 uint64_t DLFinalizedProgram::symbolAddress(std::string symbolName,
-                                           Elf64_Sym *) {
+                                           Elf64_Sym *Symbol) {
 
   void *dlh = dlhandle();
   if (dlh == nullptr)
     return 0;
+
+  // Symbols defined in the binary itself are at their ELF value relative
+  // to the load base. Thread local and indirect symbols need the dynamic
+  // linker to resolve them.
+  if (Symbol != nullptr && Symbol->st_shndx != SHN_UNDEF &&
+      ELF64_ST_TYPE(Symbol->st_info) != STT_TLS &&
+      ELF64_ST_TYPE(Symbol->st_info) != STT_GNU_IFUNC && LoadBase != 0)
+    return LoadBase + Symbol->st_value;
+
   dlerror();
 
   assert(symbolName.size() != 0);
@@ -114,69 +265,168 @@ uint64_t DLFinalizedProgram::symbolAddress(std::string symbolName,
   return (uint64_t)symbolAddress;
 }
 
-std::size_t DLFinalizedProgram::serializedSize() const {
-  std::size_t Size = 0;
-  Size += sizeof(std::size_t);
-  Size += elfSize();
-  Size += sizeof(ISA);
-  Size += sizeof(DefaultRoundingMode);
-  Size += sizeof(Profile);
-  Size += sizeof(MachineModel);
-
-  return Size;
+std::vector<char> DLFinalizedProgram::serializedPayload(
+    uint32_t &Compression) const {
+  Compression = SerializedUncompressed;
+#ifdef PHSA_HAVE_ZSTD
+  const char *CompressionEnv = std::getenv("PHSA_CODE_OBJECT_COMPRESSION");
+  if (CompressionEnv != nullptr &&
+      std::string(CompressionEnv) == "zstd") {
+    std::vector<char> Compressed(ZSTD_compressBound(elfSize()));
+    size_t Size = ZSTD_compress(Compressed.data(), Compressed.size(),
+                                elfBlob(), elfSize(), ZSTD_CLEVEL_DEFAULT);
+    if (!ZSTD_isError(Size) && Size < elfSize()) {
+      Compressed.resize(Size);
+      Compression = SerializedZstd;
+      return Compressed;
+    }
+  }
+#endif
+  return std::vector<char>();
 }
 
-void DLFinalizedProgram::serializeTo(uint8_t *Buffer) const {
-  std::size_t ES = elfSize();
-  memcpy(Buffer, &ES, sizeof(ES));
-  Buffer += sizeof(ES);
-  memcpy(Buffer, elfBlob(), elfSize());
-  Buffer += elfSize();
-  memcpy(Buffer, &ISA, sizeof(ISA));
-  Buffer += sizeof(ISA);
-  memcpy(Buffer, &DefaultRoundingMode, sizeof(DefaultRoundingMode));
-  Buffer += sizeof(DefaultRoundingMode);
-  memcpy(Buffer, &Profile, sizeof(Profile));
-  Buffer += sizeof(Profile);
-  memcpy(Buffer, &MachineModel, sizeof(MachineModel));
+std::vector<uint8_t> DLFinalizedProgram::serialize() const {
+  uint32_t Compression;
+  std::vector<char> CompressedPayload = serializedPayload(Compression);
+
+  SerializedHeader Header;
+  std::memset(&Header, 0, sizeof(Header));
+  std::memcpy(Header.Magic, SerializedMagic, sizeof(Header.Magic));
+  Header.Version = SerializedVersion;
+  Header.HeaderSize = sizeof(Header);
+  Header.Compression = Compression;
+  Header.Profile = Profile;
+  Header.MachineModel = MachineModel;
+  Header.RoundingMode = DefaultRoundingMode;
+  std::string ISAName = ::ISA::fromHSAObject(ISA);
+  std::strncpy(Header.ISA, ISAName.c_str(), sizeof(Header.ISA) - 1);
+  Header.PayloadOffset = SerializedPayloadOffset;
+  const char *Payload =
+      CompressedPayload.empty() ? elfBlob() : CompressedPayload.data();
+  Header.PayloadSize =
+      CompressedPayload.empty() ? elfSize() : CompressedPayload.size();
+  Header.ELFSize = elfSize();
+  Header.PayloadChecksum = checksum64(Payload, Header.PayloadSize);
+  Header.HeaderChecksum =
+      checksum64(&Header, offsetof(SerializedHeader, HeaderChecksum));
+
+  std::vector<uint8_t> Serialized(SerializedPayloadOffset +
+                                  Header.PayloadSize);
+  std::memcpy(Serialized.data(), &Header, sizeof(Header));
+  std::memcpy(Serialized.data() + SerializedPayloadOffset, Payload,
+              Header.PayloadSize);
+  return Serialized;
 }
 
-DLFinalizedProgram *DLFinalizedProgram::deserialize(uint8_t *Buffer) {
-  std::size_t ES = 0;
-  memcpy(&ES, Buffer, sizeof(ES));
-  Buffer += sizeof(ES);
-
-  uint8_t *ElfBlob = new uint8_t[ES];
-  memcpy(ElfBlob, Buffer, ES);
-  Buffer += ES;
-
-  hsa_isa_t ISA;
-  memcpy(&ISA, Buffer, sizeof(ISA));
-  Buffer += sizeof(ISA);
-  hsa_default_float_rounding_mode_t DefaultRoundingMode;
-  memcpy(&DefaultRoundingMode, Buffer, sizeof(DefaultRoundingMode));
-  Buffer += sizeof(DefaultRoundingMode);
-  hsa_profile_t Profile;
-  memcpy(&Profile, Buffer, sizeof(Profile));
-  Buffer += sizeof(Profile);
-  hsa_machine_model_t MachineModel;
-  memcpy(&MachineModel, Buffer, sizeof(MachineModel));
-
-  // Dump binary back to disk
-  char *tempDirC = nullptr;
-  char *dirTemplate = strdup("/tmp/phsa-finalized-program-XXXXXX");
-  assert((tempDirC = mkdtemp(dirTemplate)) != nullptr);
-  boost::filesystem::path tempDir(tempDirC);
-  boost::filesystem::create_directories(tempDir);
-  boost::filesystem::path outPath(tempDir / "temp.elf");
-  std::ofstream outfile(outPath.string(), std::ofstream::binary);
-  outfile.write(reinterpret_cast<char *>(ElfBlob), ES);
+DLFinalizedProgram *DLFinalizedProgram::deserialize(const uint8_t *Buffer,
+                                                    std::size_t Size,
+                                                    bool ReferenceBuffer) {
+  SerializedHeader Header;
+  if (Size < sizeof(Header))
+    return nullptr;
+  std::memcpy(&Header, Buffer, sizeof(Header));
+  if (std::memcmp(Header.Magic, SerializedMagic, sizeof(Header.Magic)) != 0 ||
+      Header.Version != SerializedVersion ||
+      Header.HeaderSize != sizeof(Header) ||
+      Header.HeaderChecksum !=
+          checksum64(&Header, offsetof(SerializedHeader, HeaderChecksum)) ||
+      Header.PayloadOffset < sizeof(Header) || Header.PayloadOffset > Size ||
+      Header.PayloadSize > Size - Header.PayloadOffset ||
+      Header.ISA[sizeof(Header.ISA) - 1] != '\0')
+    return nullptr;
 
-  auto Ret = new DLFinalizedProgram(reinterpret_cast<char *>(ElfBlob), ES, ISA,
-                                    MachineModel, Profile, DefaultRoundingMode);
+  const uint8_t *Payload = Buffer + Header.PayloadOffset;
+  if (checksum64(Payload, Header.PayloadSize) != Header.PayloadChecksum)
+    return nullptr;
 
-  Ret->setBinFileName(outPath.string());
+  hsa_isa_t ISA = ::ISA::toHSAObject(Header.ISA);
+  if (::ISA::fromHSAObject(ISA).empty())
+    return nullptr;
 
+  std::shared_ptr<char> ElfBlob;
+  switch (Header.Compression) {
+  case SerializedUncompressed:
+    if (Header.PayloadSize != Header.ELFSize)
+      return nullptr;
+    // The ELF is accessed in place, which requires its natural alignment.
+    if (ReferenceBuffer &&
+        reinterpret_cast<uintptr_t>(Payload) % alignof(Elf64_Ehdr) == 0) {
+      ElfBlob.reset(reinterpret_cast<char *>(const_cast<uint8_t *>(Payload)),
+                    [](char *) {});
+    } else {
+      ElfBlob.reset(new char[Header.ELFSize], std::default_delete<char[]>());
+      std::memcpy(ElfBlob.get(), Payload, Header.ELFSize);
+    }
+    break;
+#ifdef PHSA_HAVE_ZSTD
+  case SerializedZstd: {
+    ElfBlob.reset(new char[Header.ELFSize], std::default_delete<char[]>());
+    size_t Decompressed = ZSTD_decompress(ElfBlob.get(), Header.ELFSize,
+                                          Payload, Header.PayloadSize);
+    if (ZSTD_isError(Decompressed) || Decompressed != Header.ELFSize)
+      return nullptr;
+    break;
+  }
+#endif
+  default:
+    return nullptr;
+  }
+
+  auto Ret = new DLFinalizedProgram(
+      ElfBlob, Header.ELFSize, ISA,
+      static_cast<hsa_machine_model_t>(Header.MachineModel),
+      static_cast<hsa_profile_t>(Header.Profile),
+      static_cast<hsa_default_float_rounding_mode_t>(Header.RoundingMode));
+
+  if (!Ret->createBinaryImage()) {
+    delete Ret;
+    return nullptr;
+  }
   return Ret;
 }
+
+bool DLFinalizedProgram::createBinaryImage() {
+  int Fd = createMemFile("phsa-finalized-program", elfBlob(), elfSize());
+  if (Fd == -1 || access(procFdPath(Fd).c_str(), R_OK) != 0) {
+    if (Fd != -1)
+      close(Fd);
+    return writeTempBinFile();
+  }
+
+  // dlopen() identifies the already loaded objects also by their names.
+  // A library that was loaded through the same descriptor number before
+  // might still be resident, so move to a number not used by any.
+  std::vector<int> Stale;
+  void *Resident;
+  while ((Resident = dlopen(procFdPath(Fd).c_str(),
+                            RTLD_LAZY | RTLD_NOLOAD)) != nullptr) {
+    dlclose(Resident);
+    int NewFd = fcntl(Fd, F_DUPFD_CLOEXEC, Fd + 1);
+    Stale.push_back(Fd);
+    Fd = NewFd;
+    if (Fd == -1)
+      break;
+  }
+  for (int S : Stale)
+    close(S);
+  if (Fd == -1)
+    return writeTempBinFile();
+
+  BinaryFd = Fd;
+  setBinFileName(procFdPath(Fd));
+  return true;
+}
+
+bool DLFinalizedProgram::writeTempBinFile() {
+  char dirTemplate[] = "/tmp/phsa-finalized-program-XXXXXX";
+  if (mkdtemp(dirTemplate) == nullptr)
+    return false;
+  boost::filesystem::path outPath(boost::filesystem::path(dirTemplate) /
+                                  "temp.elf");
+  std::ofstream outfile(outPath.string(), std::ofstream::binary);
+  // Set the name first so the directory gets removed also on failure.
+  setBinFileName(outPath.string());
+  TempBinFile = true;
+  return static_cast<bool>(outfile.write(elfBlob(), elfSize()));
+}
 }
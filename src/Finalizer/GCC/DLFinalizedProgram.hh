@@ -26,6 +26,7 @@
 #ifndef PHSA_DLFINALIZEDPROGRAM_HH
 #define PHSA_DLFINALIZEDPROGRAM_HH
 
+#include <atomic>
 #include <mutex>
 #include <cassert>
 #include <unordered_map>
@@ -44,26 +45,94 @@ public:
   DLFinalizedProgram(char *ElfBlob, size_t ElfSize, hsa_isa_t ISA,
                      hsa_machine_model_t MM, hsa_profile_t P,
                      hsa_default_float_rounding_mode_t RM);
+  DLFinalizedProgram(std::shared_ptr<char> ElfBlob, size_t ElfSize,
+                     hsa_isa_t ISA, hsa_machine_model_t MM, hsa_profile_t P,
+                     hsa_default_float_rounding_mode_t RM);
   virtual ~DLFinalizedProgram();
 
   /// Returns the dlopen() handle for the finalized binary, if feasible.
   /// dlopens the .so in case not opened yet.
   void *dlhandle();
 
+  /// Places the ELF blob to an in-memory file private to this program
+  /// and points the binary file name to it. Falls back to a temporary
+  /// file in case memfd_create() or /proc is not available. Each program
+  /// must be loaded from a file of its own, as dlopen() returns the same
+  /// instance, with the same global variables, for a file that is
+  /// already loaded.
+  bool createBinaryImage();
+
   void defineGlobalSymbolAddress(std::string SymbolName,
                                  uint64_t Addr) override;
 
+  /// The first executables share the library loaded for this program. An
+  /// executable with different host definitions gets a copy of its own,
+  /// loaded from the same ELF blob, so the global variables of the
+  /// executables stay isolated. The copies are kept for reuse until the
+  /// program is destroyed.
+  FinalizedProgram *acquire(const SymbolAddressIndex &HostDefinitions) override;
+  void release() override;
+
   /// Returns the address of the symbol in memory. Returns the address in
-  /// the current process memory for the CPU/dlopen case.
+  /// the current process memory for the CPU/dlopen case. The address of a
+  /// symbol defined in the binary is computed from its ELF symbol, if given,
+  /// without a dlsym() lookup.
   uint64_t symbolAddress(std::string SymbolName,
                          Elf64_Sym *Symbol = nullptr) override;
 
-  virtual std::size_t serializedSize() const override;
-  virtual void serializeTo(uint8_t *Buffer) const override;
-  static DLFinalizedProgram *deserialize(uint8_t *Buffer);
+  /// The serialized format is versioned and checksummed. The ELF binary
+  /// is compressed with zstd in case PHSA_CODE_OBJECT_COMPRESSION is set
+  /// to "zstd" and the support was built in.
+  virtual std::vector<uint8_t> serialize() const override;
+
+  /// Returns nullptr in case the buffer is not a valid serialized code
+  /// object. With ReferenceBuffer, the ELF binary is used in place instead
+  /// of copying it in case it's uncompressed and suitably aligned. The
+  /// buffer must then outlive the program.
+  static DLFinalizedProgram *deserialize(const uint8_t *Buffer,
+                                         std::size_t Size,
+                                         bool ReferenceBuffer = false);
 
 private:
-  void *Dlhandle;
+  enum SerializedCompression : uint32_t {
+    SerializedUncompressed = 0,
+    SerializedZstd = 1
+  };
+
+  /// The compressed ELF binary, or an empty vector in case it's not
+  /// compressed.
+  std::vector<char> serializedPayload(uint32_t &Compression) const;
+
+  bool writeTempBinFile();
+
+  /// Returns the location of the pointer the binary uses for the given host
+  /// defined symbol, or nullptr in case it does not refer to the symbol.
+  char **hostDefinitionSlot(std::string SymbolName);
+
+  /// Sets up an unused instance for the given host definitions.
+  void useFor(const SymbolAddressIndex &HostDefinitions);
+
+  /// Set once the binary is opened, after LoadBase.
+  std::atomic<void *> Dlhandle;
+  /// The difference of the loaded addresses to the ELF symbol values.
+  uint64_t LoadBase;
+  /// Serializes opening the binary.
+  std::mutex DlopenLock;
+  /// The memfd the binary is loaded from, or -1.
+  int BinaryFd;
+  /// True in case the binary file is in a temporary directory of its own.
+  bool TempBinFile;
+
+  /// The number of executables using this instance.
+  unsigned Users;
+  /// The host definitions the instance was set up with.
+  SymbolAddressIndex HostDefinitions;
+  /// The program this is a copy of, or nullptr for the original.
+  DLFinalizedProgram *Original;
+  /// The copies for differing host definitions.
+  std::vector<std::unique_ptr<DLFinalizedProgram>> Instances;
+  /// Protects the users of the program and its copies.
+  std::mutex InstanceLock;
 };
 
 } // namespace phsa
@@ -23,28 +23,73 @@
 #include "ELFExecutable.hh"
 #include "FinalizedProgram.hh"
 #include <algorithm>
+#include <boost/utility/string_ref.hpp>
+#include <cstring>
+#include <iterator>
 #include <assert.h>
 #include <elf.h>
 
 namespace phsa {
 
+namespace {
+
+#define PHSA_KERNEL_PREFIX "phsa_kernel."
+
+const boost::string_ref PHSAKernelPrefix(PHSA_KERNEL_PREFIX);
+
+// The compiler internal symbols hidden from the executable, sorted for
+// a binary search.
+const boost::string_ref HiddenSymbols[] = {
+    "_DYNAMIC",
+    "_GLOBAL_OFFSET_TABLE_",
+    "__FRAME_END__",
+    "__TMC_END__",
+    "__do_global_dtors_aux_fini_array_entry",
+    "__dso_handle",
+    "__frame_dummy_init_array_entry",
+    "deregister_tm_clones",
+    "frame_dummy",
+    "register_tm_clones"};
+
+// PHSA kernels are always currently single WI kernels which do not
+// use any local memory. They are detected from a known function name
+// prefix.
+bool isPHSAKernel(boost::string_ref Name) {
+  return Name.size() > PHSAKernelPrefix.size() &&
+         Name.starts_with(PHSAKernelPrefix);
+}
+
+bool isHiddenSymbol(boost::string_ref Name) {
+  return std::binary_search(std::begin(HiddenSymbols), std::end(HiddenSymbols),
+                            Name);
+}
+
+} // namespace
+
+ELFExecutable::~ELFExecutable() {
+  for (FinalizedProgram *Program : Programs) {
+    Program->removeExecutable(*this);
+    Program->release();
+  }
+}
+
 HSAReturnValue<>
 ELFExecutable::LoadCodeObject(phsa::Agent *Agent,
                               const hsa_code_object_t CodeObject,
                               const char *Options) {
 
-  phsa::FinalizedProgram *Program =
+  phsa::FinalizedProgram *CodeObjectProgram =
       phsa::FinalizedProgram::fromHSAObject(CodeObject);
 
-  if (Program == nullptr) {
+  if (CodeObjectProgram == nullptr) {
     return HSAReturn(HSA_STATUS_ERROR_INVALID_CODE_OBJECT);
   }
 
-  for (auto s : DefinedSymbols) {
-    std::string Name = s.first;
-    uint64_t Addr = s.second;
-
-    Program->defineGlobalSymbolAddress(Name, Addr);
+  // The instance of the program with the host definitions of this
+  // executable, possibly shared with other executables.
+  phsa::FinalizedProgram *Program = CodeObjectProgram->acquire(DefinedSymbols);
+  if (Program == nullptr) {
+    return HSAReturn(HSA_STATUS_ERROR_OUT_OF_RESOURCES);
   }
 
   Elf64_Shdr *SectionHeader = nullptr;
@@ -72,106 +117,164 @@ ELFExecutable::LoadCodeObject(phsa::Agent *Agent,
   Elf64_Sym *Symbols = static_cast<Elf64_Sym *>(DataDesc->d_buf);
   std::size_t SymbolCount = SectionHeader->sh_size / SectionHeader->sh_entsize;
 
+  const char *StringTable = nullptr;
+  Elf_Scn *StringSection = elf_getscn(ELF, SectionHeader->sh_link);
+  Elf_Data *StringData =
+      StringSection != nullptr ? elf_getdata(StringSection, nullptr) : nullptr;
+  if (StringData != nullptr)
+    StringTable = static_cast<const char *>(StringData->d_buf);
+  std::size_t StringTableSize = StringData != nullptr ? StringData->d_size : 0;
+
+  bool Lazy = FinalizedProgram::lazyLoading();
   for (std::size_t I = 0; I < SymbolCount; ++I) {
     Elf64_Sym Symbol = Symbols[I];
-    std::string SymbolName =
-        elf_strptr(ELF, SectionHeader->sh_link, Symbol.st_name);
-
-#define PHSA_KERNEL_PREFIX "phsa_kernel."
+    if (Symbol.st_name == 0 || Symbol.st_name >= StringTableSize)
+      continue;
+    // The name might not be terminated within a corrupted string table.
+    const char *NameStart = StringTable + Symbol.st_name;
+    boost::string_ref SymbolName(
+        NameStart, strnlen(NameStart, StringTableSize - Symbol.st_name));
 
-    // PHSA kernels are always currently single WI kernels which do not
-    // use any local memory. They are detected from a known function name
-    // prefix.
-    bool IsPHSAKernel =
-      SymbolName.size() > strlen(PHSA_KERNEL_PREFIX) &&
-      SymbolName.substr(0, strlen(PHSA_KERNEL_PREFIX)) == PHSA_KERNEL_PREFIX;
+    bool IsPHSAKernel = isPHSAKernel(SymbolName);
 
     // Hide some uninteresting / compiler internal symbols. TODO:
     // most of these are likely external symbols which can be skipped by
     // checking for it.
-    if (SymbolName.size() == 0 ||
+    if (SymbolName.empty() ||
         (!IsPHSAKernel && SymbolName.size() > 7 &&
-	 SymbolName.substr(0, 8) != "gccbrig." &&
-         SymbolName.find(".") != std::string::npos) ||
-        SymbolName == "frame_dummy" ||
-        SymbolName == "__do_global_dtors_aux_fini_array_entry" ||
-        SymbolName == "__frame_dummy_init_array_entry" ||
-        SymbolName == "__FRAME_END__" ||
-        SymbolName == "__dso_handle" ||
-        SymbolName == "_DYNAMIC" ||
-        SymbolName == "__TMC_END__" ||
-        SymbolName == "_GLOBAL_OFFSET_TABLE_" ||
-        SymbolName == "register_tm_clones" ||
-        SymbolName == "deregister_tm_clones")
+         !SymbolName.starts_with("gccbrig.") &&
+         SymbolName.find('.') != boost::string_ref::npos) ||
+        isHiddenSymbol(SymbolName))
       continue;
 
+    // Only kernels and variables are registered. A symbol of any type is
+    // a kernel in case it has a kernel descriptor.
     phsa_descriptor *Descriptor = Program->findDescriptor(SymbolName);
-    bool IsKernel = Descriptor != nullptr && Descriptor->is_kernel;
-
-    if (IsKernel) {
-      Kernel *K = new Kernel;
-      K->Name = std::string("&") + SymbolName;
-      K->Type = HSA_SYMBOL_KIND_KERNEL;
-      K->ModuleName = "";
-      K->Agent = NULL;
-      K->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
-      K->IsDefinition = true;
-
-      K->Object = reinterpret_cast<uint64_t>(K);
-      K->Address = (void *)Program->symbolAddress(SymbolName, &Symbol);
-      K->KernargSegmentSize = Descriptor->kernarg_segment_size;
-      K->KernargSegmentAlignment =
-          std::max((uint16_t)MIN_ALIGNMENT, Descriptor->kernarg_max_align);
-      K->GroupSegmentSize = Descriptor->group_segment_size;
-      K->PrivateSegmentSize = Descriptor->private_segment_size;
-      K->DynamicCallStack = false; // TODO
-      K->ImplementationData = Program;
-
-      Program->addSymbol(K);
-      registerSymbol(K);
-    } else if (IsPHSAKernel) {
-      Kernel *K = new Kernel;
-      K->Name = std::string("&") + SymbolName;
-      K->Type = HSA_SYMBOL_KIND_KERNEL;
-      K->ModuleName = "";
-      K->Agent = NULL;
-      K->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
-      K->IsDefinition = true;
-
-      K->Object = reinterpret_cast<uint64_t>(K);
-      K->Address = (void *)Program->symbolAddress(SymbolName, &Symbol);
-      K->KernargSegmentSize = 2048;
-      K->KernargSegmentAlignment = 1;
-
-      K->GroupSegmentSize = 0;
-      K->PrivateSegmentSize = 0;
-      K->DynamicCallStack = false;
-      K->ImplementationData = Program;
-
-      Program->addSymbol(K);
-      registerSymbol(K);
-    } else if ((Symbol.st_info & 0x0f) == STT_OBJECT) {
-      Variable *V = new Variable;
-      V->Name = std::string("&") + SymbolName;
-      V->Type = HSA_SYMBOL_KIND_VARIABLE;
-      V->ModuleName = "";
-      // TODO: Support agent-scope variables properly.
-      V->Agent = NULL;
-      V->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
-      V->IsDefinition = true;
-      V->Address = (void *)Program->symbolAddress(SymbolName, &Symbol);
-      Program->addSymbol(V);
-      registerSymbol(V);
+    if (ELF64_ST_TYPE(Symbol.st_info) != STT_OBJECT && !IsPHSAKernel &&
+        (Descriptor == nullptr || !Descriptor->is_kernel))
+      continue;
+
+    if (Lazy) {
+      SymbolIndex::CanonicalName Canonical(SymbolName, boost::string_ref());
+      PendingSymbolsByName.insert({Canonical.hash(), PendingSymbols.size()});
+      PendingSymbols.push_back(
+          {Program, Symbol, SymbolName, Descriptor, false});
     } else {
-      // TODO: other program/module scope symbol types.
+      createSymbol(Program, Symbol, SymbolName, Descriptor);
     }
   }
-  Program->setExecutable(*this);
+  Program->addExecutable(*this);
+  Programs.push_back(Program);
 
   free(ELF);
 
   return HSAReturn(HSA_STATUS_SUCCESS);
 }
 
+Symbol *ELFExecutable::createSymbol(FinalizedProgram *Program,
+                                    Elf64_Sym &Symbol,
+                                    boost::string_ref SymbolName,
+                                    phsa_descriptor *Descriptor) {
+  std::lock_guard<std::mutex> L(Program->symbolLock());
+  // Another executable sharing the program might have created it already.
+  if (phsa::Symbol *Loaded = Program->findLoadedSymbol(SymbolName)) {
+    registerSymbol(Loaded);
+    return Loaded;
+  }
+
+  bool IsPHSAKernel = isPHSAKernel(SymbolName);
+  unsigned char SymbolType = ELF64_ST_TYPE(Symbol.st_info);
+
+  std::string Name = SymbolName.to_string();
+  bool IsKernel = Descriptor != nullptr && Descriptor->is_kernel;
+
+  if (IsKernel) {
+    Kernel *K = new Kernel;
+    K->Name = "&" + Name;
+    K->Type = HSA_SYMBOL_KIND_KERNEL;
+    K->ModuleName = "";
+    K->Agent = NULL;
+    K->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
+    K->IsDefinition = true;
+
+    K->Object = reinterpret_cast<uint64_t>(K);
+    K->Address = (void *)Program->symbolAddress(Name, &Symbol);
+    K->KernargSegmentSize = Descriptor->kernarg_segment_size;
+    K->KernargSegmentAlignment =
+        std::max((uint16_t)MIN_ALIGNMENT, Descriptor->kernarg_max_align);
+    K->GroupSegmentSize = Descriptor->group_segment_size;
+    K->PrivateSegmentSize = Descriptor->private_segment_size;
+    K->DynamicCallStack = false; // TODO
+    K->ImplementationData = Program;
+
+    Program->addSymbol(K);
+    registerSymbol(K);
+    return K;
+  } else if (IsPHSAKernel) {
+    Kernel *K = new Kernel;
+    K->Name = "&" + Name;
+    K->Type = HSA_SYMBOL_KIND_KERNEL;
+    K->ModuleName = "";
+    K->Agent = NULL;
+    K->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
+    K->IsDefinition = true;
+
+    K->Object = reinterpret_cast<uint64_t>(K);
+    K->Address = (void *)Program->symbolAddress(Name, &Symbol);
+    K->KernargSegmentSize = 2048;
+    K->KernargSegmentAlignment = 1;
+
+    K->GroupSegmentSize = 0;
+    K->PrivateSegmentSize = 0;
+    K->DynamicCallStack = false;
+    K->ImplementationData = Program;
+
+    Program->addSymbol(K);
+    registerSymbol(K);
+    return K;
+  } else if (SymbolType == STT_OBJECT) {
+    Variable *V = new Variable;
+    V->Name = "&" + Name;
+    V->Type = HSA_SYMBOL_KIND_VARIABLE;
+    V->ModuleName = "";
+    // TODO: Support agent-scope variables properly.
+    V->Agent = NULL;
+    V->Linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
+    V->IsDefinition = true;
+    V->Address = (void *)Program->symbolAddress(Name, &Symbol);
+    Program->addSymbol(V);
+    registerSymbol(V);
+    return V;
+  }
+  // TODO: other program/module scope symbol types.
+  return nullptr;
+}
+
+Symbol *ELFExecutable::loadSymbol(boost::string_ref Name,
+                                  boost::string_ref ModuleName) {
+  SymbolIndex::CanonicalName Canonical(Name, ModuleName);
+  // The pending names lack the leading '&' of the canonical names.
+  boost::string_ref ELFName = Canonical.str().substr(1);
+  auto Range = PendingSymbolsByName.equal_range(Canonical.hash());
+  for (auto I = Range.first; I != Range.second; ++I) {
+    PendingSymbol &P = PendingSymbols[I->second];
+    if (P.Loaded || P.Name != ELFName)
+      continue;
+    P.Loaded = true;
+    if (Symbol *S = createSymbol(P.Program, P.Symbol, P.Name, P.Descriptor))
+      return S;
+  }
+  return nullptr;
+}
+
+void ELFExecutable::loadPendingSymbols() {
+  for (PendingSymbol &P : PendingSymbols) {
+    if (!P.Loaded)
+      createSymbol(P.Program, P.Symbol, P.Name, P.Descriptor);
+  }
+  PendingSymbols.clear();
+  PendingSymbolsByName.clear();
+}
+
 } // namespace phsa
 
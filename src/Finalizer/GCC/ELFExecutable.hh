@@ -23,9 +23,13 @@
 #ifndef HSA_RUNTIME_ELFEXECUTABLE_HH
 #define HSA_RUNTIME_ELFEXECUTABLE_HH
 
+#include <boost/utility/string_ref.hpp>
 #include <cstring>
+#include <elf.h>
 #include <libelf.h>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #include "Executable.hh"
 #include "common/Logging.hh"
@@ -36,12 +40,14 @@
 
 namespace phsa {
 
+class FinalizedProgram;
+
 // Handles ELFs produced by the GCC BRIG frontend.
 class ELFExecutable : public Executable {
 public:
   ELFExecutable(hsa_profile_t Profile, bool IsFrozen)
       : Executable(IsFrozen), Profile(Profile) {}
-  virtual ~ELFExecutable() {}
+  virtual ~ELFExecutable();
 
   virtual hsa_profile_t getProfile() const override { return Profile; }
 
@@ -49,8 +55,32 @@ public:
                                           const hsa_code_object_t CodeObject,
                                           const char *Options) override;
 
+protected:
+  virtual Symbol *loadSymbol(boost::string_ref Name,
+                             boost::string_ref ModuleName) override;
+  virtual void loadPendingSymbols() override;
+
 private:
+  // A symbol of a lazily loaded code object, registered once it's looked
+  // up. The name points to the string table in the ELF blob of the program.
+  struct PendingSymbol {
+    FinalizedProgram *Program;
+    Elf64_Sym Symbol;
+    boost::string_ref Name;
+    phsa_descriptor *Descriptor;
+    bool Loaded;
+  };
+
+  // Creates and registers the symbol in case it's a kernel or a variable.
+  // Descriptor is the function descriptor of the symbol, if any.
+  Symbol *createSymbol(FinalizedProgram *Program, Elf64_Sym &Symbol,
+                       boost::string_ref Name, phsa_descriptor *Descriptor);
+
   hsa_profile_t Profile;
+  std::vector<FinalizedProgram *> Programs;
+  std::vector<PendingSymbol> PendingSymbols;
+  // Indices to PendingSymbols by the hash of the canonical symbol name.
+  std::unordered_multimap<uint64_t, std::size_t> PendingSymbolsByName;
 };
 
 } // namespace phsa
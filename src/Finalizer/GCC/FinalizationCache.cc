@@ -0,0 +1,171 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A persistent on-disk cache of finalized binaries.
+ */
+
+#include "FinalizationCache.hh"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace phsa {
+
+namespace {
+
+const char *EntrySuffix = ".so";
+const std::uintmax_t DefaultSizeLimit = 512 * 1024 * 1024;
+const std::string TempPrefix = ".tmp-";
+// Temporary files older than this are leftovers even if their pid is
+// alive, e.g. when it has been reused or belongs to another pid namespace.
+const std::time_t StaleTempAge = 60 * 60;
+
+// Returns true if the given temporary file was left behind by a process
+// that can no longer finish writing it.
+bool isStaleTemp(const std::string &Name, std::time_t Time) {
+  if (std::time(nullptr) - Time > StaleTempAge)
+    return true;
+  char *End;
+  long Pid = std::strtol(Name.c_str() + TempPrefix.size(), &End, 10);
+  if (End == Name.c_str() + TempPrefix.size() || *End != '-' || Pid <= 0)
+    return true;
+  return kill(static_cast<pid_t>(Pid), 0) != 0 && errno == ESRCH;
+}
+
+} // namespace
+
+FinalizationCache::FinalizationCache(std::string Directory,
+                                     std::uintmax_t SizeLimit)
+    : Directory(Directory), SizeLimit(SizeLimit) {
+  boost::system::error_code Error;
+  boost::filesystem::create_directories(Directory, Error);
+}
+
+FinalizationCache *FinalizationCache::get() {
+  static std::unique_ptr<FinalizationCache> Cache;
+  static std::once_flag Initialized;
+  std::call_once(Initialized, []() {
+    const char *DirEnv = std::getenv("PHSA_FINALIZER_CACHE_DIR");
+    if (DirEnv == nullptr || *DirEnv == '\0')
+      return;
+    const char *SizeEnv = std::getenv("PHSA_FINALIZER_CACHE_SIZE");
+    std::uintmax_t SizeLimit = SizeEnv != nullptr
+                                   ? std::strtoull(SizeEnv, nullptr, 10)
+                                   : DefaultSizeLimit;
+    Cache.reset(new FinalizationCache(DirEnv, SizeLimit));
+  });
+  return Cache.get();
+}
+
+std::string FinalizationCache::entryPath(const std::string &Key) const {
+  return Directory + "/" + Key + EntrySuffix;
+}
+
+std::string FinalizationCache::lookup(const std::string &Key) {
+  std::string Path = entryPath(Key);
+  boost::system::error_code Error;
+  if (!boost::filesystem::is_regular_file(Path, Error))
+    return "";
+  // Failing to update the LRU time is harmless.
+  boost::filesystem::last_write_time(Path, std::time(nullptr), Error);
+  return Path;
+}
+
+void FinalizationCache::store(const std::string &Key, const char *Binary,
+                              std::size_t Size) {
+  using namespace boost::filesystem;
+  // The temporary file must be on the same file system for the rename
+  // to be atomic, and must not look like an entry to the other processes.
+  path TempPath =
+      unique_path(Directory + "/" + TempPrefix + std::to_string(getpid()) +
+                  "-%%%%%%%%");
+  {
+    std::ofstream Out(TempPath.string(), std::ofstream::binary);
+    if (!Out.write(Binary, Size)) {
+      std::cerr << "phsa-finalizer: could not write to the finalizer cache in "
+                << Directory << "." << std::endl;
+      boost::system::error_code Error;
+      remove(TempPath, Error);
+      return;
+    }
+  }
+
+  boost::system::error_code Error;
+  rename(TempPath, entryPath(Key), Error);
+  if (Error) {
+    remove(TempPath, Error);
+    return;
+  }
+  evict();
+}
+
+void FinalizationCache::evict() {
+  using namespace boost::filesystem;
+  boost::system::error_code Error;
+
+  std::vector<std::pair<std::time_t, path>> Entries;
+  std::uintmax_t TotalSize = 0;
+  for (directory_iterator I(Directory, Error), E; !Error && I != E;
+       I.increment(Error)) {
+    const path &Entry = I->path();
+    std::string Name = Entry.filename().string();
+    if (Name.compare(0, TempPrefix.size(), TempPrefix) == 0) {
+      // Sweep the temporary files of crashed or killed writers.
+      boost::system::error_code TimeError, RemoveError;
+      std::time_t Time = last_write_time(Entry, TimeError);
+      if (!TimeError && isStaleTemp(Name, Time))
+        remove(Entry, RemoveError);
+      continue;
+    }
+    if (Entry.extension() != EntrySuffix)
+      continue;
+    boost::system::error_code SizeError, TimeError;
+    std::uintmax_t Size = file_size(Entry, SizeError);
+    std::time_t Time = last_write_time(Entry, TimeError);
+    if (SizeError || TimeError)
+      continue;
+    TotalSize += Size;
+    Entries.push_back(std::make_pair(Time, Entry));
+  }
+  if (TotalSize <= SizeLimit)
+    return;
+
+  std::sort(Entries.begin(), Entries.end());
+  for (auto &Entry : Entries) {
+    if (TotalSize <= SizeLimit)
+      break;
+    // Another process might have evicted it already.
+    std::uintmax_t Size = file_size(Entry.second, Error);
+    if (!Error && remove(Entry.second, Error))
+      TotalSize -= Size;
+  }
+}
+
+} // namespace phsa
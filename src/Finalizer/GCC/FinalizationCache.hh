@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A persistent on-disk cache of finalized binaries.
+ */
+
+#ifndef HSA_RUNTIME_FINALIZATIONCACHE_HH
+#define HSA_RUNTIME_FINALIZATIONCACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace phsa {
+
+// Stores finalized binaries in a directory under file names derived
+// from a content hash of everything that affects the compilation. The
+// directory can be shared by concurrent processes: entries are written
+// to a temporary file that is then atomically renamed in place. The
+// total size of the entries is kept under a limit by evicting the least
+// recently used ones, tracked with the modification times of the files.
+// Temporary files left behind by dead writers are removed at eviction.
+//
+// The cache is enabled by setting PHSA_FINALIZER_CACHE_DIR. The size
+// limit in bytes can be set with PHSA_FINALIZER_CACHE_SIZE.
+class FinalizationCache {
+public:
+  FinalizationCache(std::string Directory, std::uintmax_t SizeLimit);
+
+  // Returns the path of the binary cached for Key, or an empty string if
+  // there is none. Marks the entry as recently used.
+  std::string lookup(const std::string &Key);
+
+  // Stores the given binary for Key and evicts the least recently used
+  // entries in case the size limit is exceeded.
+  void store(const std::string &Key, const char *Binary, std::size_t Size);
+
+  // Returns the cache configured in the environment, or nullptr if the
+  // cache is not enabled.
+  static FinalizationCache *get();
+
+private:
+  std::string entryPath(const std::string &Key) const;
+  void evict();
+
+  std::string Directory;
+  std::uintmax_t SizeLimit;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_FINALIZATIONCACHE_HH
@@ -21,27 +21,90 @@
  *         for General Processor Tech.
  */
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
+#include <unistd.h>
 
 #include "HSAILProgram.hh"
 #include "DLFinalizedProgram.hh"
 #include "Brig.h"
 #include "common/Logging.hh"
 #include "common/Debug.hh"
+#include "common/Hash.hh"
+#include "common/MemFile.hh"
+#include "common/Process.hh"
+#include "CodeBundle.hh"
+#include "CompileServer.hh"
+#include "FinalizationCache.hh"
 #include "GCCFinalizer.hh"
+#include "ISA.hh"
 
 namespace phsa {
 
-HSAReturnValue<hsa_code_object_s> GCCFinalizer::finalizeProgram(
-    hsa_ext_program_t Program, hsa_ext_control_directives_t ControlDirectives,
-    hsa_isa_t ISA, const char *VendorCompilerOptions) {
+namespace {
 
+// Reads the file at Path to a new[] allocated buffer.
+bool readBinary(const std::string &Path, char *&Blob, size_t &Length) {
+  std::ifstream elf(Path.c_str(), std::ios::binary);
+  if (!elf.is_open())
+    return false;
+
+  // Get length of the file.
+  elf.seekg(0, std::ios::end);
+  Length = elf.tellg();
+  elf.seekg(0, std::ios::beg);
+
+  Blob = new char[Length];
+  if (!elf.read(Blob, Length)) {
+    delete[] Blob;
+    return false;
+  }
+  return true;
+}
+
+// The compilation timeout requested with PHSA_COMPILER_TIMEOUT in
+// seconds, zero for none.
+unsigned compilerTimeoutMs() {
+  const char *TimeoutEnv = std::getenv("PHSA_COMPILER_TIMEOUT");
+  if (TimeoutEnv == nullptr)
+    return 0;
+  return std::max(0, std::atoi(TimeoutEnv)) * 1000;
+}
+
+std::string joinArguments(const std::vector<std::string> &Argv) {
+  std::string CommandLine;
+  for (const std::string &Arg : Argv)
+    CommandLine += (CommandLine.empty() ? "" : " ") + Arg;
+  return CommandLine;
+}
+
+// The features of the host CPU, which affect the binaries as they are
+// compiled with -march=native.
+std::string hostCPUFeatures() {
+  std::ifstream CPUInfo("/proc/cpuinfo");
+  std::string Line;
+  while (std::getline(CPUInfo, Line)) {
+    if (Line.compare(0, 5, "flags") == 0 || Line.compare(0, 8, "Features") == 0)
+      return Line;
+  }
+  return "";
+}
+
+} // namespace
+
+bool GCCFinalizer::compilerConfiguration(const std::string &GCCBinary,
+                                         const char *VendorCompilerOptions,
+                                         std::string &CompilerBinary,
+                                         std::string &inputFlags,
+                                         std::string &compileFlags) {
   // Call gcc's BRIG FE from the command line. There seems not to be a clean
   // library interface for frontend services in gcc which could be used
   // to feed in the in memory BRIG directly. Also, this should avoid force
@@ -59,79 +122,40 @@ HSAReturnValue<hsa_code_object_s> GCCFinalizer::finalizeProgram(
     if (!exists(brigFrontendBin)) {
       std::cerr << "phsa-finalizer: gccbrig binary not found in "
                 << brigFrontendBin << "." << std::endl;
-      return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
-                       hsa_code_object_t());
+      return false;
     }
   }
+  CompilerBinary = brigFrontendBin.string();
 
   std::string phsaRTFlags;
-  phsa::HSAILProgram &prog = *phsa::HSAILProgram::fromHSAObject(Program);
-
-  if (!prog.hasModules()) {
-    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_INVALID_PROGRAM,
-                     hsa_code_object_t());
-  }
-
-  char *compilerTempEnv = std::getenv("PHSA_COMPILER_TEMP_DIR");
-  path tempDir;
-  if (compilerTempEnv != nullptr)
-    tempDir = path(compilerTempEnv);
-  else {
-    char *tempDirC = nullptr;
-    char *dirTemplate = strdup("/tmp/phsa-finalizer-XXXXXX");
-    if ((tempDirC = mkdtemp(dirTemplate)) == nullptr) {
-      std::cerr << "phsa-finalizer: could not create a compiler temp directory."
-                << std::endl;
-      return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
-                       hsa_code_object_t());
-    }
-    tempDir = path(tempDirC);
-  }
-
-  create_directories(tempDir);
-  std::string brigPaths;
-
   const bool DEBUG_MODE = phsa::IsDebugMode();
 
-  std::vector<std::string> BRIGPaths;
-  if (!prog.dumpBRIGS(tempDir.string(), BRIGPaths))
-    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
-                     hsa_code_object_t());
-
-  std::string LastBrigFile;
-  std::string BrigFiles;
-  for (std::string BrigPath : BRIGPaths) {
-    BrigFiles += BrigPath + " ";
-    LastBrigFile = BrigPath;
-  }
-
-  std::string dynObjectPath = LastBrigFile + ".so";
-  std::string compileCmd = brigFrontendBin.string() +
-                           " -frounding-math -fno-use-linker-plugin"
-                           " -march=native"
-                           " -lm -fPIC " +
-                           BrigFiles + " " + phsaRTFlags +
-                           " -shared -fPIC -o " + dynObjectPath + " ";
+  // The flags given before the input files.
+  inputFlags = " -frounding-math -fno-use-linker-plugin"
+               " -march=native"
+               " -lm -fPIC ";
 
+  // The flags given after the output file.
+  compileFlags = phsaRTFlags;
   if (DEBUG_MODE) {
-    compileCmd += " -v ";
+    compileFlags += " -v ";
   }
 
   char *ldflags = std::getenv("LDFLAGS");
   if (ldflags != nullptr)
-    compileCmd += std::string(ldflags) + " ";
+    compileFlags += std::string(ldflags) + " ";
 
   if (RT_SOURCES) {
-    compileCmd +=
+    compileFlags +=
         std::string(" -I") + brigFrontendBuildDirEnv + "/gcc/include" + " ";
-    compileCmd += std::string(" -I") + brigFrontendBuildDirEnv +
-                  "/gcc/include-fixed" + " ";
+    compileFlags += std::string(" -I") + brigFrontendBuildDirEnv +
+                    "/gcc/include-fixed" + " ";
 
     char *phsaRTIncDir = std::getenv("PHSA_RUNTIME_INC_DIR");
     if (phsaRTIncDir != nullptr) {
-      compileCmd += std::string(" -I") + std::string(phsaRTIncDir) + " ";
+      compileFlags += std::string(" -I") + std::string(phsaRTIncDir) + " ";
     }
-    compileCmd += "-flto ";
+    compileFlags += "-flto ";
   }
 
   if (VendorCompilerOptions != NULL) {
@@ -139,44 +163,368 @@ HSAReturnValue<hsa_code_object_s> GCCFinalizer::finalizeProgram(
     std::string option;
     while (optss >> option) {
       if (option == "-phsa_strict-aliasing")
-        compileCmd += "-fstrict-aliasing ";
+        compileFlags += "-fstrict-aliasing ";
     }
   }
 
   char *additionalFlags = std::getenv("PHSA_COMPILER_FLAGS");
   if (additionalFlags != nullptr)
-    compileCmd += std::string(additionalFlags);
+    compileFlags += std::string(additionalFlags);
+
+  if (DEBUG_MODE) {
+    compileFlags += " -fdump-tree-all -save-temps ";
+  }
+  return true;
+}
+
+std::string GCCFinalizer::compilerIdentity(const std::string &Binary) {
+  std::lock_guard<std::mutex> L(CompilerIdentitiesLock);
+  auto Identity = CompilerIdentities.find(Binary);
+  if (Identity != CompilerIdentities.end())
+    return Identity->second;
+  std::string Id =
+      runProcess({Binary, "--version"}).Output + hostCPUFeatures();
+  CompilerIdentities[Binary] = Id;
+  return Id;
+}
+
+std::string GCCFinalizer::finalizationKey(
+    HSAILProgram &Program, unsigned __int128 BRIGHash,
+    hsa_ext_control_directives_t ControlDirectives, hsa_isa_t ISA,
+    const char *VendorCompilerOptions, const std::string &CompileFlags,
+    const std::string &CompilerBinary) {
+  ContentHash Hash;
+  Hash.addValue(BRIGHash);
+  Hash.add(::ISA::fromHSAObject(ISA));
+  Hash.addValue(Program.getMachineModel());
+  Hash.addValue(Program.getProfile());
+  Hash.addValue(Program.getDefaultRoundingMode());
+
+  // Hash the fields separately to skip the reserved bytes.
+  Hash.addValue(ControlDirectives.control_directives_mask);
+  Hash.addValue(ControlDirectives.break_exceptions_mask);
+  Hash.addValue(ControlDirectives.detect_exceptions_mask);
+  Hash.addValue(ControlDirectives.max_dynamic_group_size);
+  Hash.addValue(ControlDirectives.max_flat_grid_size);
+  Hash.addValue(ControlDirectives.max_flat_workgroup_size);
+  Hash.addValue(ControlDirectives.required_grid_size);
+  Hash.addValue(ControlDirectives.required_workgroup_size.x);
+  Hash.addValue(ControlDirectives.required_workgroup_size.y);
+  Hash.addValue(ControlDirectives.required_workgroup_size.z);
+  Hash.addValue(ControlDirectives.required_dim);
+
+  Hash.add(VendorCompilerOptions != nullptr ? VendorCompilerOptions : "");
+  Hash.add(CompileFlags);
+  Hash.add(compilerIdentity(CompilerBinary));
+  return Hash.hex();
+}
+
+bool GCCFinalizer::produceBinary(const std::string &CompilerBinary,
+                                 HSAILProgram &prog, const std::string &Key,
+                                 const char *VendorCompilerOptions,
+                                 const std::string &inputFlags,
+                                 const std::string &compileFlags,
+                                 FinalizedBinary &Binary) {
+  const bool DEBUG_MODE = phsa::IsDebugMode();
+  char *elfBlob = nullptr;
+  size_t length = 0;
+
+  FinalizationCache *Cache = FinalizationCache::get();
+  if (Cache != nullptr) {
+    std::string CachedPath = Cache->lookup(Key);
+    if (!CachedPath.empty() && readBinary(CachedPath, elfBlob, length)) {
+      if (DEBUG_MODE) {
+        std::cout << "phsa-finalizer: using cached " << CachedPath
+                  << std::endl;
+      }
+      Binary.ELFBlob.reset(elfBlob, std::default_delete<char[]>());
+      Binary.ELFSize = length;
+      return true;
+    }
+  }
+
+  std::vector<BRIGModule> Modules;
+  for (size_t i = 0; i < prog.moduleCount(); ++i) {
+    const BrigModuleHeader *Header =
+        (const BrigModuleHeader *)prog.module(i);
+    Modules.push_back({Header, Header->byteCount});
+  }
+
+  // Prefer a compile server in case one is configured and running. The
+  // server compiles with its own compiler and flags.
+  std::string Diagnostics;
+  bool Compiled = false;
+  bool ServerCompiled = false;
+  char *serverEnv = std::getenv("PHSA_COMPILER_SERVER");
+  CompileServer::Request Request{
+      VendorCompilerOptions != nullptr ? VendorCompilerOptions : "", Modules};
+  if (serverEnv == nullptr ||
+      !CompileServer::compile(serverEnv, Request, compilerTimeoutMs(),
+                              Binary, Compiled, Diagnostics)) {
+    Compiled = compileBinary(CompilerBinary, Modules, inputFlags,
+                             compileFlags, Binary, Diagnostics);
+  } else {
+    ServerCompiled = true;
+    if (DEBUG_MODE) {
+      std::cout << "phsa-finalizer: compiled by the server at " << serverEnv
+                << std::endl;
+    }
+  }
+  std::cerr << Diagnostics;
+  if (!Compiled)
+    return false;
+
+  // The key describes the local compiler configuration, so a binary of
+  // the server is not cached under it. The server keeps its own.
+  if (Cache != nullptr && !ServerCompiled)
+    Cache->store(Key, Binary.ELFBlob.get(), Binary.ELFSize);
+  return true;
+}
+
+bool GCCFinalizer::compileBinary(const std::string &CompilerBinary,
+                                 const std::vector<BRIGModule> &Modules,
+                                 const std::string &inputFlags,
+                                 const std::string &compileFlags,
+                                 FinalizedBinary &Binary,
+                                 std::string &Diagnostics) {
+  using namespace boost::filesystem;
+  const bool DEBUG_MODE = phsa::IsDebugMode();
+  std::ostringstream Messages;
+
+  // Each finalization gets a directory of its own, also under a
+  // PHSA_COMPILER_TEMP_DIR, so concurrent finalizations do not clash.
+  // The directory is only needed until the binary has been read in.
+  char *compilerTempEnv = std::getenv("PHSA_COMPILER_TEMP_DIR");
+  path tempRoot = compilerTempEnv != nullptr ? path(compilerTempEnv)
+                                             : path("/tmp");
+  boost::system::error_code createError;
+  create_directories(tempRoot, createError);
+  std::string dirTemplate = (tempRoot / "phsa-finalizer-XXXXXX").string();
+  if (mkdtemp(&dirTemplate[0]) == nullptr) {
+    Diagnostics += "phsa-finalizer: could not create a compiler temp "
+                   "directory.\n";
+    return false;
+  }
+  path tempDir(dirTemplate);
+
+  // The BRIG modules are passed to the compiler as in-memory files it
+  // inherits. They are dumped to files in the debug mode for inspection,
+  // or in case in-memory files are not supported.
+  std::vector<int> BRIGFds;
+  std::vector<std::string> BRIGPaths;
+  for (size_t i = 0; i < Modules.size() && !DEBUG_MODE; ++i) {
+    int Fd = createMemFile("phsa-brig", Modules[i].Data, Modules[i].Size);
+    if (Fd == -1) {
+      for (int F : BRIGFds)
+        close(F);
+      BRIGFds.clear();
+      break;
+    }
+    BRIGFds.push_back(Fd);
+  }
+  if (!BRIGFds.empty()) {
+    for (int Fd : childDescriptors(BRIGFds))
+      BRIGPaths.push_back(procFdPath(Fd));
+  } else {
+    for (size_t i = 0; i < Modules.size(); ++i) {
+      std::string BrigPath =
+          (tempDir / ("module" + std::to_string(i) + ".brig")).string();
+      std::ofstream Outfile(BrigPath.c_str(), std::ofstream::binary);
+      if (!Outfile.write((const char *)Modules[i].Data, Modules[i].Size)) {
+        Diagnostics += "phsa-finalizer: could not write " + BrigPath + ".\n";
+        return false;
+      }
+      BRIGPaths.push_back(BrigPath);
+    }
+  }
+
+  std::string dynObjectPath = (tempDir / "program.so").string();
+  std::vector<std::string> compileArgs = splitArguments(inputFlags);
+  compileArgs.insert(compileArgs.begin(), CompilerBinary);
+  compileArgs.push_back("-x");
+  compileArgs.push_back("brig");
+  compileArgs.insert(compileArgs.end(), BRIGPaths.begin(), BRIGPaths.end());
+  for (const char *Arg : {"-x", "none", "-shared", "-fPIC", "-o"})
+    compileArgs.push_back(Arg);
+  compileArgs.push_back(dynObjectPath);
+  for (const std::string &Arg : splitArguments(compileFlags))
+    compileArgs.push_back(Arg);
+  std::string compileCmd = joinArguments(compileArgs);
 
   if (DEBUG_MODE) {
-    compileCmd += " -fdump-tree-all -save-temps ";
     std::cout << "phsa-finalizer: running: " << compileCmd << std::endl;
   }
-  int status = std::system(compileCmd.c_str());
-  if (status == -1 || WEXITSTATUS(status) != 0) {
-    std::cerr << "phsa-finalizer: command failed: " << compileCmd << std::endl;
+  ProcessResult Compilation =
+      runProcess(compileArgs, BRIGFds, compilerTimeoutMs());
+  for (int Fd : BRIGFds)
+    close(Fd);
+
+  if (DEBUG_MODE) {
+    std::cout << Compilation.Output;
+    std::cerr << Compilation.Errors;
+  }
+  bool Compiled = Compilation.succeeded();
+  if (!Compiled) {
+    Messages << "phsa-finalizer: command "
+             << (Compilation.TimedOut ? "timed out" : "failed") << ": "
+             << compileCmd << std::endl;
+    if (!DEBUG_MODE)
+      Messages << Compilation.Errors;
+  }
+
+  // Read in the produced ELF .so. The rest is taken care of by
+  // Portable-HSA-Runtime, which loads it from memory.
+  char *elfBlob = nullptr;
+  size_t length = 0;
+  bool Read = Compiled && readBinary(dynObjectPath, elfBlob, length);
+  if (Compiled && !Read)
+    Messages << "phsa-finalizer: could not read " << dynObjectPath << "."
+             << std::endl;
+
+  if (!DEBUG_MODE) {
+    boost::system::error_code removeError;
+    remove_all(tempDir, removeError);
+  }
+  Diagnostics += Messages.str();
+  if (!Read)
+    return false;
+
+  Binary.ELFBlob.reset(elfBlob, std::default_delete<char[]>());
+  Binary.ELFSize = length;
+  return true;
+}
+
+HSAReturnValue<hsa_code_object_s> GCCFinalizer::finalizedFromBundle(
+    const uint8_t *CodeObject, size_t Size,
+    hsa_ext_control_directives_t ControlDirectives) {
+  // The bundles stay mapped, so the ELF can be used in place.
+  phsa::DLFinalizedProgram *finalizedProg =
+      phsa::DLFinalizedProgram::deserialize(CodeObject, Size, true);
+  if (finalizedProg == nullptr)
     return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
                      hsa_code_object_t());
+
+  if (!finalizedProg->loadAndCheckControlDirectives(ControlDirectives)) {
+    delete finalizedProg;
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_DIRECTIVE_MISMATCH,
+                     hsa_code_object_t());
   }
+  return HSAReturn((hsa_status_t)::HSA_STATUS_SUCCESS,
+                   finalizedProg->toHSAObject());
+}
 
-  // Read in the produced ELF .so. The rest is taken care of by
-  // Portable-HSA-Runtime.
-  std::ifstream elf;
-  elf.open(dynObjectPath.c_str(), std::ios::binary);
+void GCCFinalizer::pruneMemo() {
+  if (Memo.size() < MemoPruneSize)
+    return;
+  for (auto It = Memo.begin(); It != Memo.end();) {
+    if (!It->second.Finalizing.valid() && It->second.ELFBlob.expired())
+      It = Memo.erase(It);
+    else
+      ++It;
+  }
+  MemoPruneSize = std::max<size_t>(64, Memo.size() * 2);
+}
 
-  // Get length of the file.
-  elf.seekg(0, std::ios::end);
-  size_t length = elf.tellg();
-  elf.seekg(0, std::ios::beg);
+HSAReturnValue<hsa_code_object_s> GCCFinalizer::finalizeProgram(
+    hsa_ext_program_t Program, hsa_ext_control_directives_t ControlDirectives,
+    hsa_isa_t ISA, const char *VendorCompilerOptions) {
 
-  char *elfBlob = new char[length];
-  elf.read(elfBlob, length);
-  elf.close();
+  phsa::HSAILProgram *progPtr = phsa::HSAILProgram::fromHSAObject(Program);
+  if (progPtr == nullptr) {
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_INVALID_PROGRAM,
+                     hsa_code_object_t());
+  }
+  phsa::HSAILProgram &prog = *progPtr;
+
+  if (!prog.hasModules()) {
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_INVALID_PROGRAM,
+                     hsa_code_object_t());
+  }
+
+  // The modules are hashed once for both the bundle lookup and the key.
+  unsigned __int128 brigHash = CodeBundle::brigHash(prog);
+
+  // Programs finalized ahead of time need no compiler.
+  if (CodeBundle::anyLoaded()) {
+    size_t bundledSize;
+    const uint8_t *bundled = CodeBundle::findLoaded(
+        CodeBundle::tagsOf(prog, ISA, brigHash), bundledSize);
+    if (bundled != nullptr)
+      return finalizedFromBundle(bundled, bundledSize, ControlDirectives);
+  }
+
+  std::string brigFrontendBin, inputFlags, compileFlags;
+  if (!compilerConfiguration(GCCBinary, VendorCompilerOptions, brigFrontendBin,
+                             inputFlags, compileFlags))
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
+                     hsa_code_object_t());
+
+  std::string Key =
+      finalizationKey(prog, brigHash, ControlDirectives, ISA,
+                      VendorCompilerOptions, inputFlags + compileFlags,
+                      brigFrontendBin);
+
+  // Finalize each distinct program only once while its binary is in use,
+  // also when the same program is being finalized concurrently in another
+  // thread.
+  FinalizedBinary Binary;
+  std::shared_future<FinalizedBinary> Finalized;
+  std::promise<FinalizedBinary> Finalizing;
+  bool FinalizesHere = false;
+  {
+    std::lock_guard<std::mutex> L(MemoLock);
+    auto Memoized = Memo.find(Key);
+    if (Memoized != Memo.end()) {
+      if (Memoized->second.Finalizing.valid()) {
+        Finalized = Memoized->second.Finalizing;
+      } else {
+        Binary.ELFBlob = Memoized->second.ELFBlob.lock();
+        Binary.ELFSize = Memoized->second.ELFSize;
+      }
+    }
+    if (!Finalized.valid() && Binary.ELFBlob == nullptr) {
+      Finalized = Finalizing.get_future().share();
+      Memo[Key].Finalizing = Finalized;
+      FinalizesHere = true;
+    }
+  }
+
+  if (FinalizesHere) {
+    FinalizedBinary Produced;
+    bool Succeeded = produceBinary(brigFrontendBin, prog, Key,
+                                   VendorCompilerOptions, inputFlags,
+                                   compileFlags, Produced);
+    {
+      std::lock_guard<std::mutex> L(MemoLock);
+      if (Succeeded) {
+        MemoEntry &Entry = Memo[Key];
+        Entry.Finalizing = std::shared_future<FinalizedBinary>();
+        Entry.ELFBlob = Produced.ELFBlob;
+        Entry.ELFSize = Produced.ELFSize;
+        pruneMemo();
+      } else {
+        // Let the later calls retry.
+        Memo.erase(Key);
+      }
+    }
+    Finalizing.set_value(Produced);
+  }
+
+  if (Finalized.valid())
+    Binary = Finalized.get();
+  if (Binary.ELFBlob == nullptr)
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
+                     hsa_code_object_t());
 
   phsa::DLFinalizedProgram *finalizedProg = new phsa::DLFinalizedProgram(
-      elfBlob, length, ISA, prog.getMachineModel(), prog.getProfile(),
-      prog.getDefaultRoundingMode());
+      Binary.ELFBlob, Binary.ELFSize, ISA, prog.getMachineModel(),
+      prog.getProfile(), prog.getDefaultRoundingMode());
 
-  finalizedProg->setBinFileName(dynObjectPath);
+  if (!finalizedProg->createBinaryImage()) {
+    delete finalizedProg;
+    return HSAReturn((hsa_status_t)::HSA_EXT_STATUS_ERROR_FINALIZATION_FAILED,
+                     hsa_code_object_t());
+  }
 
   if (!finalizedProg->loadAndCheckControlDirectives(ControlDirectives)) {
     delete finalizedProg;
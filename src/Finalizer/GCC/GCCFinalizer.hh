@@ -24,7 +24,13 @@
 #ifndef HSA_RUNTIME_GCCFINALIZER_HH
 #define HSA_RUNTIME_GCCFINALIZER_HH
 
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "Finalizer.hh"
 
@@ -33,6 +39,8 @@
 
 namespace phsa {
 
+class HSAILProgram;
+
 class GCCFinalizer : public Finalizer {
 public:
   GCCFinalizer(std::string GCCBinaryName = "gccbrig")
@@ -43,8 +51,84 @@ public:
                   hsa_ext_control_directives_t ControlDirectives,
                   hsa_isa_t VendorCompilerOptions, const char *string) override;
 
+  // An ELF binary produced by the finalizer. Shared by all the programs
+  // finalized from the same input.
+  struct FinalizedBinary {
+    std::shared_ptr<char> ELFBlob;
+    size_t ELFSize = 0;
+  };
+
+  // A BRIG module in memory.
+  struct BRIGModule {
+    const void *Data;
+    size_t Size;
+  };
+
+  // Compiles the BRIG modules to a binary with the given compiler in a
+  // child process. The error messages are appended to Diagnostics.
+  static bool compileBinary(const std::string &CompilerBinary,
+                            const std::vector<BRIGModule> &Modules,
+                            const std::string &InputFlags,
+                            const std::string &CompileFlags,
+                            FinalizedBinary &Binary, std::string &Diagnostics);
+
+  // The compiler binary and the flags to finalize with, as configured
+  // with the environment of this process and the given vendor options.
+  // Returns false in case the configured compiler does not exist.
+  static bool compilerConfiguration(const std::string &GCCBinary,
+                                    const char *VendorCompilerOptions,
+                                    std::string &CompilerBinary,
+                                    std::string &InputFlags,
+                                    std::string &CompileFlags);
+
 private:
+  // Returns a new code object deserialized from a code bundle.
+  HSAReturnValue<hsa_code_object_s>
+  finalizedFromBundle(const uint8_t *CodeObject, size_t Size,
+                      hsa_ext_control_directives_t ControlDirectives);
+
+  // Produces the binary for the program with the given key, either from
+  // the disk cache, by a compile server or by compiling it.
+  bool produceBinary(const std::string &CompilerBinary, HSAILProgram &Program,
+                     const std::string &Key, const char *VendorCompilerOptions,
+                     const std::string &InputFlags,
+                     const std::string &CompileFlags, FinalizedBinary &Binary);
+
+  // The version of the given compiler binary and the features of the
+  // host CPU it compiles for.
+  std::string compilerIdentity(const std::string &Binary);
+
+  // A hash of everything that affects the finalization of the program.
+  // BRIGHash is the CodeBundle::brigHash() of the program.
+  std::string finalizationKey(HSAILProgram &Program,
+                              unsigned __int128 BRIGHash,
+                              hsa_ext_control_directives_t ControlDirectives,
+                              hsa_isa_t ISA, const char *VendorCompilerOptions,
+                              const std::string &CompileFlags,
+                              const std::string &CompilerBinary);
+
   std::string GCCBinary;
+  std::map<std::string, std::string> CompilerIdentities;
+  std::mutex CompilerIdentitiesLock;
+
+  // A binary finalized in this process. While the finalization is in
+  // progress, the other callers wait for Finalizing. Afterwards only a
+  // weak reference is kept so that the binary is freed with the last code
+  // object using it.
+  struct MemoEntry {
+    std::shared_future<FinalizedBinary> Finalizing;
+    std::weak_ptr<char> ELFBlob;
+    size_t ELFSize = 0;
+  };
+
+  // Removes the entries of the freed binaries once the memo has doubled
+  // in size since the previous time. Called with MemoLock held.
+  void pruneMemo();
+
+  // The binaries finalized in this process, by finalization key.
+  std::unordered_map<std::string, MemoEntry> Memo;
+  size_t MemoPruneSize = 64;
+  std::mutex MemoLock;
 };
 
 }
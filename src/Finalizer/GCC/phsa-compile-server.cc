@@ -0,0 +1,65 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Runs a compile server for the phsa-runtime finalizer until interrupted.
+ *
+ * Usage: phsa-compile-server [socket path]
+ *
+ * The socket path defaults to PHSA_COMPILER_SERVER. The requests are
+ * served in PHSA_FINALIZER_THREADS threads.
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <pthread.h>
+
+#include "common/ThreadPool.hh"
+#include "CompileServer.hh"
+
+int main(int argc, char *argv[]) {
+  const char *SocketPath =
+      argc > 1 ? argv[1] : std::getenv("PHSA_COMPILER_SERVER");
+  if (SocketPath == nullptr) {
+    std::cerr << "usage: " << argv[0] << " [socket path]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Blocked before starting the server threads so that they inherit the
+  // mask and the signals are left to sigwait() below.
+  sigset_t Signals;
+  sigemptyset(&Signals);
+  sigaddset(&Signals, SIGINT);
+  sigaddset(&Signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &Signals, nullptr);
+
+  phsa::CompileServer Server(
+      SocketPath,
+      phsa::ThreadPool::threadCountFromEnvironment("PHSA_FINALIZER_THREADS"));
+  if (!Server.start()) {
+    std::cerr << "phsa-compile-server: could not listen at " << SocketPath
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int Signal;
+  sigwait(&Signals, &Signal);
+  Server.stop();
+  return EXIT_SUCCESS;
+}
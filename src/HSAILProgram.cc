@@ -43,46 +43,11 @@ HSAILProgram::HSAILProgram(hsa_machine_model_t MM, hsa_profile_t P,
                            hsa_default_float_rounding_mode_t RM)
     : MachineModel(MM), Profile(P), DefaultRoundingMode(RM) {}
 
-HSAILProgram::~HSAILProgram() {
-  if (!IsDebugMode()) {
-    for (std::string FName : TempFiles) {
-      unlink(FName.c_str());
-    }
-  }
-}
+HSAILProgram::~HSAILProgram() {}
 
 bool HSAILProgram::hasModule(hsa_ext_module_t module) const {
   return std::find(BRIGs.begin(), BRIGs.end(), module) != BRIGs.end();
 }
 
-// Dump all BRIGs to temporary files.
-bool HSAILProgram::dumpBRIGS(std::string TempDir,
-                             std::vector<std::string> &Paths) {
-
-  const bool DEBUG_MODE = phsa::IsDebugMode();
-
-  for (size_t i = 0; i < moduleCount(); ++i) {
-
-    const BrigModuleHeader *Header = (const BrigModuleHeader *)module(i);
-    std::string BrigPath;
-    BrigPath = (boost::filesystem::unique_path(std::string(TempDir.c_str()) +
-                                               "/%%%%%%%%%%%%.brig"))
-                   .string();
-    std::ofstream Outfile(BrigPath.c_str(), std::ofstream::binary);
-
-    if (!Outfile.is_open())
-      return false;
-
-    // Dump the in-memory BRIG to a temp file, trust that its size header is OK
-    // for now. What else can we do here?
-    Outfile.write((char *)Header, Header->byteCount);
-    Outfile.close();
-
-    addTempFile(BrigPath);
-    Paths.push_back(BrigPath);
-  }
-  return true;
-}
-
 } // namespace phsa
 
@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The image extension.
+ */
+
+#include "ImageExtension.hh"
+
+#include "hsa_ext_image.h"
+
+Extension::Identifier ImageExtension::getIdentifier() const {
+  return HSA_EXTENSION_IMAGES;
+}
+
+void ImageExtension::fillExtensionTable(void *table) const {
+  hsa_ext_images_1_00_pfn_t *Table =
+      static_cast<hsa_ext_images_1_00_pfn_t *>(table);
+  Table->hsa_ext_image_get_capability = hsa_ext_image_get_capability;
+  Table->hsa_ext_image_data_get_info = hsa_ext_image_data_get_info;
+  Table->hsa_ext_image_create = hsa_ext_image_create;
+  Table->hsa_ext_image_destroy = hsa_ext_image_destroy;
+  Table->hsa_ext_image_copy = hsa_ext_image_copy;
+  Table->hsa_ext_image_import = hsa_ext_image_import;
+  Table->hsa_ext_image_export = hsa_ext_image_export;
+  Table->hsa_ext_image_clear = hsa_ext_image_clear;
+  Table->hsa_ext_sampler_create = hsa_ext_sampler_create;
+  Table->hsa_ext_sampler_destroy = hsa_ext_sampler_destroy;
+}
@@ -0,0 +1,45 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The phsa-runtime vendor extension.
+ */
+
+#include "PHSAExtension.hh"
+
+#include "hsa_ext_phsa.h"
+
+Extension::Identifier PHSAExtension::getIdentifier() const {
+  return HSA_EXTENSION_PHSA;
+}
+
+void PHSAExtension::fillExtensionTable(void *table) const {
+  hsa_ext_phsa_1_00_pfn_t *Table =
+      static_cast<hsa_ext_phsa_1_00_pfn_t *>(table);
+  Table->hsa_ext_phsa_program_finalize_batch =
+      hsa_ext_phsa_program_finalize_batch;
+  Table->hsa_ext_phsa_set_finalizer_thread_count =
+      hsa_ext_phsa_set_finalizer_thread_count;
+  Table->hsa_ext_phsa_program_finalize_async =
+      hsa_ext_phsa_program_finalize_async;
+  Table->hsa_ext_phsa_code_bundle_create = hsa_ext_phsa_code_bundle_create;
+  Table->hsa_ext_phsa_code_bundle_load = hsa_ext_phsa_code_bundle_load;
+  Table->hsa_ext_phsa_code_bundle_find = hsa_ext_phsa_code_bundle_find;
+  Table->hsa_ext_phsa_image_import = hsa_ext_phsa_image_import;
+  Table->hsa_ext_phsa_image_export = hsa_ext_phsa_image_export;
+}
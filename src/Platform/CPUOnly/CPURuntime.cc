@@ -28,12 +28,19 @@
 #include "Devices/CPU/GCCBuiltinSignal.hh"
 #include "Finalizer/GCC/GCCFinalizer.hh"
 #include "ISA.hh"
+#include "ImageExtension.hh"
+#include "PHSAExtension.hh"
+#include "hsa_ext_phsa.h"
 
 namespace phsa {
 
-CPURuntime::CPURuntime() {
+CPURuntime::CPURuntime()
+    : Workers(ThreadPool::threadCountFromEnvironment("PHSA_WORKER_THREADS")),
+      Copier(Workers),
+      RegisteredMemory(Workers, HostMemoryRegistry::flagsFromEnvironment()) {
   CPUMemoryRegion *GlobalMemRegion =
-      new CPUMemoryRegion(HSA_REGION_SEGMENT_GLOBAL);
+      new CPUMemoryRegion(HSA_REGION_SEGMENT_GLOBAL,
+                          CPUMemoryRegion::pageModeFromEnvironment());
   CPUKernelAgent *CPUAgent = new CPUKernelAgent(*GlobalMemRegion);
   CPUAgent->registerMemoryRegion(GlobalMemRegion);
 
@@ -48,6 +55,16 @@ CPURuntime::CPURuntime() {
   registerAgent(CPUAgent);
   getExtensionRegistry().registerExtension(HSA_EXTENSION_FINALIZER,
                                            new GCCFinalizer);
+  getExtensionRegistry().registerExtension(HSA_EXTENSION_PHSA,
+                                           new PHSAExtension);
+  getExtensionRegistry().registerExtension(HSA_EXTENSION_IMAGES,
+                                           new ImageExtension);
+}
+
+CPURuntime::~CPURuntime() {
+  // The event handlers, the agents and the asynchronous finalizations
+  // might still copy or register memory through the members below.
+  shutDown();
 }
 
 Queue *CPURuntime::createSoftQueue(MemoryRegion *Region, uint32_t Size,
@@ -57,6 +74,27 @@ Queue *CPURuntime::createSoftQueue(MemoryRegion *Region, uint32_t Size,
   return Q;
 }
 
+void CPURuntime::copyMemory(void *Dst, const void *Src, size_t Size) {
+  Copier.copy(Dst, Src, Size);
+}
+
+void CPURuntime::copyMemoryAsync(void *Dst, const void *Src, size_t Size,
+                                 std::vector<Signal *> Dependencies,
+                                 Signal *Completion) {
+  Copier.copyAsync(Dst, Src, Size, std::move(Dependencies), Completion,
+                   isAsyncCopyProfiling());
+}
+
+hsa_status_t CPURuntime::registerMemory(void *Ptr, size_t Size, bool Pin) {
+  return RegisteredMemory.registerBuffer(
+      Ptr, Size, Pin ? HostMemoryRegistry::Prefault | HostMemoryRegistry::Lock
+                     : 0);
+}
+
+hsa_status_t CPURuntime::deregisterMemory(void *Ptr) {
+  return RegisteredMemory.deregisterBuffer(Ptr);
+}
+
 HSAReturnValue<hsa_signal_t>
 CPURuntime::createSignal(hsa_signal_value_t InitialValue) {
   Signal *Sign = new GCCBuiltinSignal(InitialValue, **MemoryRegions.begin());
@@ -24,18 +24,37 @@
 #define HSA_RUNTIME_CPURUNTIME_HH
 
 #include "Runtime.hh"
+#include "common/ThreadPool.hh"
+#include "Devices/CPU/CopyEngine.hh"
+#include "Devices/CPU/HostMemoryRegistry.hh"
 
 namespace phsa {
 
 class CPURuntime : public Runtime {
 public:
   CPURuntime();
+  ~CPURuntime();
 
   Queue *createSoftQueue(MemoryRegion *Region, uint32_t Size,
       hsa_queue_type_t Type, Signal *Doorbell) override;
 
   HSAReturnValue<hsa_signal_t>
       createSignal(hsa_signal_value_t InitialValue) override;
+
+  void copyMemory(void *Dst, const void *Src, size_t Size) override;
+  void copyMemoryAsync(void *Dst, const void *Src, size_t Size,
+                       std::vector<Signal *> Dependencies,
+                       Signal *Completion) override;
+
+  hsa_status_t registerMemory(void *Ptr, size_t Size, bool Pin) override;
+  hsa_status_t deregisterMemory(void *Ptr) override;
+
+private:
+  // Host threads for runtime services such as copying memory. The
+  // thread count can be set with PHSA_WORKER_THREADS.
+  ThreadPool Workers;
+  CopyEngine Copier;
+  HostMemoryRegistry RegisteredMemory;
 };
 
 }
@@ -32,6 +32,7 @@ boost::shared_mutex &Queue::RegistryLock =
   *(new boost::shared_mutex);
 
 std::atomic<uint64_t> Queue::QueueCount{0};
+std::atomic<uint64_t> Queue::LastCUMaskVersion{0};
 
 void Queue::garbageCollect() {
   for (auto &kv : Registry) {
@@ -49,6 +50,18 @@ void Queue::setInactivated() {
     Owner->terminateQueue(this);
 }
 
+void Queue::setComputeUnitMask(std::vector<uint32_t> Mask) {
+  std::lock_guard<std::mutex> L(CUMaskLock);
+  CUMask = std::move(Mask);
+  CUMaskVersion = CUMask.empty() ? 0 : ++LastCUMaskVersion;
+}
+
+uint64_t Queue::getComputeUnitMask(std::vector<uint32_t> &Mask) const {
+  std::lock_guard<std::mutex> L(CUMaskLock);
+  Mask = CUMask;
+  return CUMaskVersion;
+}
+
 Queue *Queue::FindQueue(const hsa_queue_t *HSAQueue) {
   return (Queue *)HSAQueue->id;
 }
@@ -22,13 +22,18 @@
 
 #include "Runtime.hh"
 
+#include <cstring>
+
 #include "Agent.hh"
+#include "amd/MemoryPool.hh"
 #include "common/Logging.hh"
 #include "Finalizer/GCC/DLFinalizedProgram.hh"
 #include "HSAILProgram.hh"
 #include "MemoryRegion.hh"
 #include "Platform/CPUOnly/CPURuntime.hh"
 #include "Queue.hh"
+#include "Signal.hh"
+#include "common/Timestamp.hh"
 
 namespace phsa {
 
@@ -37,18 +42,22 @@ std::mutex Runtime::ReferenceCounterMutex;
 Runtime *Runtime::Instance = nullptr;
 std::mutex Runtime::InstanceMutex;
 
-Runtime::Runtime() {}
+Runtime::Runtime() {
+  // Calibrate the timestamp up front instead of in the first timed wait.
+  Timestamp::frequency();
+}
 
 Runtime::~Runtime() {
-  for (auto Agent : Agents) {
-    Agent->shutDown();
+  shutDown();
+
+  for (auto Agent : Agents)
     delete Agent;
-  }
   Agents.clear();
 
   Queue::garbageCollect();
   phsa::DLFinalizedProgram::garbageCollect();
   phsa::HSAILProgram::garbageCollect();
+  MemoryPool::garbageCollect();
 
   for (auto R : MemoryRegions) {
     delete R;
@@ -56,6 +65,21 @@ Runtime::~Runtime() {
   MemoryRegions.clear();
 }
 
+void Runtime::shutDown() {
+  if (IsShutDown)
+    return;
+  IsShutDown = true;
+
+  // The handlers refer to the signals and the queues destroyed later.
+  Events.shutDown();
+
+  for (auto &E : ER)
+    E.second->shutDown();
+
+  for (auto Agent : Agents)
+    Agent->shutDown();
+}
+
 void Runtime::memoryFence() {
   // Assume the function call itself creates a fence.
 }
@@ -64,6 +88,34 @@ void Runtime::flush(void *, size_t) {
   // Assume all memory is fine-grained coherent.
 }
 
+void Runtime::copyMemory(void *Dst, const void *Src, size_t Size) {
+  std::memmove(Dst, Src, Size);
+}
+
+void Runtime::copyMemoryAsync(void *Dst, const void *Src, size_t Size,
+                              std::vector<Signal *> Dependencies,
+                              Signal *Completion) {
+  for (Signal *Dependency : Dependencies)
+    Dependency->wait([](hsa_signal_value_t Value) { return Value == 0; },
+                     std::chrono::high_resolution_clock::duration::max(),
+                     MemoryOrder::Acquire);
+  uint64_t StartTime = Timestamp::now();
+  copyMemory(Dst, Src, Size);
+  if (Completion == nullptr)
+    return;
+  if (isAsyncCopyProfiling())
+    Completion->setProfilingTimes(StartTime, Timestamp::now());
+  Completion->subtract(1, MemoryOrder::Release);
+}
+
+hsa_status_t Runtime::registerMemory(void *, size_t, bool) {
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t Runtime::deregisterMemory(void *) {
+  return HSA_STATUS_SUCCESS;
+}
+
 bool Runtime::initialize() {
   std::lock_guard<std::mutex> ReferenceCounterLock(ReferenceCounterMutex);
   if (ReferenceCounter == std::numeric_limits<int32_t>::max()) {
@@ -21,3 +21,191 @@
  */
 
 #include "Signal.hh"
+#include "common/Timestamp.hh"
+
+#include <algorithm>
+#include <vector>
+
+namespace phsa {
+
+namespace {
+
+// Up to this many signals waitAny() spins on the values unless asked to
+// block. Scanning more per iteration costs more than sleeping.
+const uint32_t SpinScanLimit = 64;
+// The number of values loaded before testing them. Lets the loads of a
+// block proceed in parallel and the tests vectorize.
+const uint32_t ScanBlock = 16;
+// How long a parked waiter sleeps before checking the values again in case
+// the changes were not notified.
+const std::chrono::milliseconds ParkPollInterval(1);
+
+// The condition as a bit mask of the comparison results it accepts, so the
+// scan can test mixed conditions without branching.
+enum : uint8_t {
+  AcceptEqual = 1,
+  AcceptNotEqual = 2,
+  AcceptLess = 4,
+  AcceptGreaterOrEqual = 8
+};
+
+uint8_t conditionMask(hsa_signal_condition_t Condition) {
+  switch (Condition) {
+  case HSA_SIGNAL_CONDITION_EQ:
+    return AcceptEqual;
+  case HSA_SIGNAL_CONDITION_NE:
+    return AcceptNotEqual;
+  case HSA_SIGNAL_CONDITION_LT:
+    return AcceptLess;
+  case HSA_SIGNAL_CONDITION_GTE:
+    return AcceptGreaterOrEqual;
+  }
+  return 0;
+}
+
+// The signals of a waitAny() laid out for scanning.
+class AnyScan {
+public:
+  AnyScan(uint32_t Count, Signal *const *Signals,
+          const hsa_signal_condition_t *Conditions,
+          const hsa_signal_value_t *Values)
+      : Count(Count), Signals(Signals), Entries(Count) {
+    for (uint32_t I = 0; I < Count; ++I) {
+      Entries[I].Address = Signals[I]->valueAddress();
+      Entries[I].CompareValue = Values[I];
+      Entries[I].Mask = conditionMask(Conditions[I]);
+    }
+  }
+
+  // Returns the index of the first satisfied signal or Signal::NoSignal.
+  uint32_t find() {
+    for (uint32_t Begin = 0; Begin < Count; Begin += ScanBlock) {
+      uint32_t End = std::min(Count, Begin + ScanBlock);
+      for (uint32_t I = Begin; I < End; ++I)
+        Entries[I].Observed = Entries[I].Address != nullptr
+                                  ? *Entries[I].Address
+                                  : Signals[I]->load(MemoryOrder::Relaxed);
+
+      uint8_t Any = 0;
+      for (uint32_t I = Begin; I < End; ++I)
+        Any |= accepts(Entries[I]);
+      if (Any == 0)
+        continue;
+
+      for (uint32_t I = Begin; I < End; ++I)
+        if (accepts(Entries[I]))
+          return I;
+    }
+    return Signal::NoSignal;
+  }
+
+  hsa_signal_value_t observed(uint32_t Index) const {
+    return Entries[Index].Observed;
+  }
+
+private:
+  struct Entry {
+    const volatile hsa_signal_value_t *Address;
+    hsa_signal_value_t CompareValue;
+    hsa_signal_value_t Observed;
+    uint8_t Mask;
+  };
+
+  static uint8_t accepts(const Entry &E) {
+    hsa_signal_value_t V = E.Observed, C = E.CompareValue;
+    uint8_t Results = (V == C) | (V != C) << 1 | (V < C) << 2 | (V >= C) << 3;
+    return Results & E.Mask;
+  }
+
+  uint32_t Count;
+  Signal *const *Signals;
+  std::vector<Entry> Entries;
+};
+
+} // namespace
+
+const uint32_t Signal::NoSignal;
+
+uint32_t Signal::waitAny(uint32_t Count, Signal *const *Signals,
+                         const hsa_signal_condition_t *Conditions,
+                         const hsa_signal_value_t *Values,
+                         std::chrono::high_resolution_clock::duration Timeout,
+                         bool Blocked, hsa_signal_value_t *SatisfyingValue) {
+  AnyScan Scan(Count, Signals, Conditions, Values);
+  bool Park = Blocked || Count > SpinScanLimit;
+
+  // Already satisfied waits do not read the clock.
+  uint32_t Index = Scan.find();
+  if (Index != NoSignal) {
+    if (SatisfyingValue != nullptr)
+      *SatisfyingValue = Scan.observed(Index);
+    return Index;
+  }
+
+  uint64_t Deadline = Timestamp::deadline(Timeout);
+  while (true) {
+    // Registered before the scan so a change after it wakes the waiter.
+    uint64_t ChangeCount = 0;
+    if (Park)
+      ChangeCount = SignalEvents::prepareSleep();
+
+    Index = Scan.find();
+    uint64_t Now = Timestamp::now();
+    if (Index != NoSignal || Now >= Deadline) {
+      if (Park)
+        SignalEvents::cancelSleep();
+      if (Index != NoSignal && SatisfyingValue != nullptr)
+        *SatisfyingValue = Scan.observed(Index);
+      return Index;
+    }
+
+    if (Park)
+      SignalEvents::sleep(ChangeCount,
+                          std::min<std::chrono::nanoseconds>(
+                              Timestamp::toDuration(Deadline - Now),
+                              ParkPollInterval));
+  }
+}
+
+std::atomic<uint64_t> SignalEvents::Changes(0);
+std::atomic<uint32_t> SignalEvents::Sleepers(0);
+std::mutex SignalEvents::SleepLock;
+std::condition_variable SignalEvents::Changed;
+
+void SignalEvents::notify() {
+  // Orders the change of the signal value before the load, pairing with
+  // the increment in prepareSleep(). Either the sleeper sees the new value
+  // or this sees the sleeper.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (Sleepers.load(std::memory_order_relaxed) == 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> L(SleepLock);
+    Changes.fetch_add(1, std::memory_order_relaxed);
+  }
+  Changed.notify_all();
+}
+
+uint64_t SignalEvents::prepareSleep() {
+  uint64_t ChangeCount = Changes.load(std::memory_order_relaxed);
+  Sleepers.fetch_add(1, std::memory_order_seq_cst);
+  return ChangeCount;
+}
+
+void SignalEvents::sleep(uint64_t ChangeCount,
+                         std::chrono::nanoseconds Timeout) {
+  {
+    std::unique_lock<std::mutex> L(SleepLock);
+    Changed.wait_for(L, Timeout, [ChangeCount]() {
+      return Changes.load(std::memory_order_relaxed) != ChangeCount;
+    });
+  }
+  Sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SignalEvents::cancelSleep() {
+  Sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+} // namespace phsa
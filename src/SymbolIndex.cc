@@ -0,0 +1,99 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Symbol lookup by canonical HSA symbol names.
+ */
+
+#include "SymbolIndex.hh"
+#include "Executable.hh"
+
+namespace phsa {
+
+SymbolIndex::CanonicalName::CanonicalName(boost::string_ref Name,
+                                          boost::string_ref ModuleName)
+    : Hash(0xcbf29ce484222325ull) {
+  if (!Name.empty() && Name.front() == '&')
+    Name.remove_prefix(1);
+  if (!ModuleName.empty() && ModuleName.front() == '&')
+    ModuleName.remove_prefix(1);
+
+  append('&');
+  if (!ModuleName.empty() || Name.find("::") != boost::string_ref::npos)
+    append("gccbrig.");
+  if (!ModuleName.empty()) {
+    append(ModuleName);
+    append('.');
+  }
+
+  // The module separators are dots and the names within a qualified
+  // name carry no '&' in the GCC mangling.
+  for (std::size_t I = 0; I < Name.size(); ++I) {
+    if (Name[I] == '&')
+      continue;
+    if (Name[I] == ':' && I + 1 < Name.size() && Name[I + 1] == ':') {
+      append('.');
+      ++I;
+      continue;
+    }
+    append(Name[I]);
+  }
+}
+
+void SymbolIndex::CanonicalName::append(char C) {
+  // 64-bit FNV-1a.
+  Hash = (Hash ^ static_cast<uint8_t>(C)) * 0x100000001b3ull;
+  if (Length < InlineNameLength) {
+    Inline[Length++] = C;
+    return;
+  }
+  if (Overflow.empty())
+    Overflow.assign(Inline, Length);
+  Overflow.push_back(C);
+  ++Length;
+}
+
+void SymbolIndex::CanonicalName::append(boost::string_ref S) {
+  for (char C : S)
+    append(C);
+}
+
+void SymbolIndex::insert(Symbol *S) {
+  CanonicalName Name(S->Name, boost::string_ref());
+  auto Range = Symbols.equal_range(Name.hash());
+  for (auto I = Range.first; I != Range.second; ++I) {
+    if (I->second.Name == Name.str()) {
+      I->second.S = S;
+      return;
+    }
+  }
+  Symbols.insert({Name.hash(), Entry{Name.str().to_string(), S}});
+}
+
+Symbol *SymbolIndex::find(boost::string_ref Name,
+                          boost::string_ref ModuleName) const {
+  CanonicalName Canonical(Name, ModuleName);
+  auto Range = Symbols.equal_range(Canonical.hash());
+  for (auto I = Range.first; I != Range.second; ++I) {
+    if (I->second.Name == Canonical.str())
+      return I->second.S;
+  }
+  return nullptr;
+}
+
+} // namespace phsa
@@ -0,0 +1,188 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Memory pools of the AMD extension API with a cache of freed blocks.
+ */
+
+#include "MemoryPool.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "MemoryRegion.hh"
+
+namespace phsa {
+
+namespace {
+
+// Align to 128 as that's the max alignment of OpenCL buffers (of double16*).
+const std::size_t MinAlignment = 128;
+
+// The smallest block size, and the largest block size kept in the cache.
+// Larger blocks are returned to the region immediately.
+const std::size_t MinBlockSize = 256;
+const std::size_t MaxCachedBlockSize = 64 * 1024 * 1024;
+
+const std::size_t DefaultCacheLimit = 256 * 1024 * 1024;
+
+std::size_t cacheLimitFromEnvironment() {
+  const char *LimitEnv = std::getenv("PHSA_POOL_CACHE_SIZE");
+  if (LimitEnv == nullptr)
+    return DefaultCacheLimit;
+  return std::strtoull(LimitEnv, nullptr, 10);
+}
+
+std::vector<MemoryPool *> Pools;
+boost::shared_mutex PoolsLock;
+
+// The blocks allocated from all the pools, so that freeing a pointer
+// finds its pool, or that it has none, with one lookup.
+struct LiveBlock {
+  MemoryPool *Pool;
+  std::size_t Class;
+};
+std::unordered_map<void *, LiveBlock> LiveBlocks;
+std::mutex LiveBlocksLock;
+
+void addLiveBlock(void *Ptr, MemoryPool *Pool, std::size_t Class) {
+  std::lock_guard<std::mutex> L(LiveBlocksLock);
+  LiveBlocks[Ptr] = LiveBlock{Pool, Class};
+}
+
+} // namespace
+
+MemoryPool::MemoryPool(MemoryRegion &Region, std::size_t CacheLimit)
+    : HSAObjectMapping([](const MemoryPool *Pool) {
+        hsa_amd_memory_pool_t Handle;
+        Handle.handle = Pool->getRegion().toHSAObject().handle;
+        return Handle;
+      }, false),
+      Region(Region), CacheLimit(CacheLimit) {
+  registerObject(this);
+}
+
+MemoryPool::~MemoryPool() { trim(); }
+
+std::size_t MemoryPool::sizeClass(std::size_t Size) {
+  if (Size <= MinBlockSize)
+    return MinBlockSize;
+  if (Size > MaxCachedBlockSize)
+    return Size;
+  // Four classes per power of two, so at most a quarter of the block
+  // is wasted.
+  unsigned Log2 = 63 - __builtin_clzll(Size - 1);
+  std::size_t Step = std::size_t(1) << (Log2 - 2);
+  return (Size + Step - 1) & ~(Step - 1);
+}
+
+std::size_t MemoryPool::getAlignment() const {
+  return std::max(MinAlignment, Region.getRuntimeAllocAlignment());
+}
+
+void *MemoryPool::allocate(std::size_t Size) {
+  std::size_t Class = sizeClass(Size);
+  std::lock_guard<std::mutex> L(PoolLock);
+
+  auto Bucket = FreeBlocks.find(Class);
+  if (Bucket != FreeBlocks.end() && !Bucket->second.empty()) {
+    void *Ptr = Bucket->second.back();
+    Bucket->second.pop_back();
+    CachedBytes -= Class;
+    addLiveBlock(Ptr, this, Class);
+    return Ptr;
+  }
+
+  void *Ptr = Region.allocate(Class, getAlignment());
+  if (Ptr == nullptr && CachedBytes > 0) {
+    // The cached blocks might be what is keeping the region full.
+    releaseCachedBlocks();
+    Ptr = Region.allocate(Class, getAlignment());
+  }
+  if (Ptr != nullptr)
+    addLiveBlock(Ptr, this, Class);
+  return Ptr;
+}
+
+void MemoryPool::release(void *Ptr, std::size_t Class) {
+  std::lock_guard<std::mutex> L(PoolLock);
+  if (Class > MaxCachedBlockSize || CachedBytes + Class > CacheLimit) {
+    Region.free(Ptr);
+    return;
+  }
+  FreeBlocks[Class].push_back(Ptr);
+  CachedBytes += Class;
+}
+
+void MemoryPool::trim() {
+  std::lock_guard<std::mutex> L(PoolLock);
+  releaseCachedBlocks();
+}
+
+void MemoryPool::releaseCachedBlocks() {
+  for (auto &Bucket : FreeBlocks)
+    for (void *Block : Bucket.second)
+      Region.free(Block);
+  FreeBlocks.clear();
+  CachedBytes = 0;
+}
+
+MemoryPool &MemoryPool::forRegion(MemoryRegion &Region) {
+  hsa_amd_memory_pool_t Handle;
+  Handle.handle = Region.toHSAObject().handle;
+  {
+    boost::shared_lock<boost::shared_mutex> L(PoolsLock);
+    if (MemoryPool *Pool = fromHSAObject(Handle))
+      return *Pool;
+  }
+
+  boost::lock_guard<boost::shared_mutex> L(PoolsLock);
+  if (MemoryPool *Pool = fromHSAObject(Handle))
+    return *Pool;
+  MemoryPool *Pool = new MemoryPool(Region, cacheLimitFromEnvironment());
+  Pools.push_back(Pool);
+  return *Pool;
+}
+
+bool MemoryPool::freeFromAnyPool(void *Ptr) {
+  LiveBlock Block;
+  {
+    std::lock_guard<std::mutex> L(LiveBlocksLock);
+    auto Found = LiveBlocks.find(Ptr);
+    if (Found == LiveBlocks.end())
+      return false;
+    Block = Found->second;
+    LiveBlocks.erase(Found);
+  }
+  Block.Pool->release(Ptr, Block.Class);
+  return true;
+}
+
+void MemoryPool::garbageCollect() {
+  boost::lock_guard<boost::shared_mutex> L(PoolsLock);
+  for (MemoryPool *Pool : Pools)
+    delete Pool;
+  Pools.clear();
+  std::lock_guard<std::mutex> BlocksLock(LiveBlocksLock);
+  LiveBlocks.clear();
+}
+
+} // namespace phsa
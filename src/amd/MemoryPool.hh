@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Memory pools of the AMD extension API with a cache of freed blocks.
+ */
+
+#ifndef HSA_RUNTIME_MEMORYPOOL_HH
+#define HSA_RUNTIME_MEMORYPOOL_HH
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "hsa_ext_amd.h"
+#include "HSAObjectMapping.hh"
+
+namespace phsa {
+
+class MemoryRegion;
+
+// A memory pool allocates from a memory region and keeps the blocks
+// freed to it in size-bucketed free lists, so frequent allocation and
+// freeing of temporaries does not reach the region allocator. The total
+// size of the cached blocks is kept under a high-water mark, set with
+// PHSA_POOL_CACHE_SIZE (in bytes).
+//
+// There is one pool per region. The opaque handle of the pool is the
+// handle of its region.
+class MemoryPool : public HSAObjectMapping<MemoryPool, hsa_amd_memory_pool_t> {
+public:
+  MemoryPool(MemoryRegion &Region, std::size_t CacheLimit);
+  ~MemoryPool();
+
+  MemoryRegion &getRegion() const { return Region; }
+
+  void *allocate(std::size_t Size);
+
+  // Returns the cached blocks to the region.
+  void trim();
+
+  // The alignment of the blocks returned by allocate().
+  std::size_t getAlignment() const;
+
+  // Returns the pool of the given region, creating it if needed.
+  static MemoryPool &forRegion(MemoryRegion &Region);
+
+  // Frees a pointer allocated from any of the pools. Returns false in
+  // case it was not allocated from a pool, which is found out with a
+  // single lookup.
+  static bool freeFromAnyPool(void *Ptr);
+
+  // Deletes all the pools. Called at runtime shutdown before the
+  // regions are destroyed.
+  static void garbageCollect();
+
+private:
+  // The size of the blocks requests of the given size are served with.
+  static std::size_t sizeClass(std::size_t Size);
+
+  // Caches the freed block of the given size class or returns it to the
+  // region.
+  void release(void *Ptr, std::size_t Class);
+
+  // Returns the cached blocks to the region. PoolLock must be held.
+  void releaseCachedBlocks();
+
+  MemoryRegion &Region;
+  const std::size_t CacheLimit;
+  std::size_t CachedBytes = 0;
+
+  // Key = size class, value = the freed blocks of the class.
+  std::unordered_map<std::size_t, std::vector<void *>> FreeBlocks;
+  std::mutex PoolLock;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_MEMORYPOOL_HH
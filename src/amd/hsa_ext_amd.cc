@@ -30,57 +30,16 @@
 
 #include "hsa_ext_amd.h"
 
-#include <memory>
 #include <vector>
-#include <map>
 
+#include "Agent.hh"
 #include "common/Logging.hh"
-
-hsa_status_t
-initialize_memory_pools(hsa_region_t region, void *data);
-
-#define HSA_CHECK_STATUS(__STATUS__, __MSG__)                           \
-  hsa_status_t status_temp_XXXX = __STATUS__;                           \
-  do { if (status_temp_XXXX != HSA_STATUS_SUCCESS) {                    \
-      std::cerr << "phsa-runtime (hsa_ext_amd wrapper) ERROR (status "  \
-                << std::hex << status_temp_XXXX << std::dec << "): "    \
-                << __MSG__ << std::endl;                                \
-      abort();                                                          \
-    } } while(false)
-
-class AgentData {
-public:
-  AgentData(hsa_agent_t agent) {
-    HSA_CHECK_STATUS(
-      hsa_agent_iterate_regions(agent, initialize_memory_pools, this),
-      "Initializing memory pools failed.");
-  }
-  ~AgentData() {
-    for (auto mp : mem_pools)
-      delete mp;
-  }
-  std::vector<hsa_amd_memory_pool_t*> mem_pools;
-};
-
-
-hsa_status_t
-initialize_memory_pools(hsa_region_t region, void *data) {
-  AgentData *agentData = (AgentData*)data;
-  hsa_amd_memory_pool_t *mem_pool = new hsa_amd_memory_pool_t;
-  mem_pool->handle = region.handle;
-  agentData->mem_pools.push_back(mem_pool);
-  return HSA_STATUS_SUCCESS;
-}
-
-// TODO: this leaks currently, which might be just fine.
-std::map<uint64_t, AgentData*> agents;
-
-static AgentData&
-get_agent_data(hsa_agent_t agent) {
-  if (agents.find(agent.handle) == agents.end())
-    agents[agent.handle] = new AgentData(agent);
-  return *agents[agent.handle];
-}
+#include "MemoryPool.hh"
+#include "MemoryRegion.hh"
+#include "Queue.hh"
+#include "Runtime.hh"
+#include "Signal.hh"
+#include "common/Timestamp.hh"
 
 hsa_status_t HSA_API hsa_amd_coherency_get_type(hsa_agent_t agent,
                                                 hsa_amd_coherency_type_t* type) {
@@ -96,36 +55,82 @@ hsa_status_t HSA_API hsa_amd_coherency_set_type(hsa_agent_t agent,
 
 hsa_status_t HSA_API hsa_amd_profiling_set_profiler_enabled(hsa_queue_t* queue,
                                                             int enable) {
-  // Unimplemented, but should not be required.
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (queue == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::Queue *Q = phsa::Queue::FindQueue(queue);
+  if (Q == nullptr || Q->isDestroyed())
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+
+  Q->setProfilingEnabled(enable != 0);
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_profiling_async_copy_enable(bool enable) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  phsa::Runtime::get().setAsyncCopyProfiling(enable);
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_profiling_get_dispatch_time(
         hsa_agent_t agent, hsa_signal_t signal,
         hsa_amd_profiling_dispatch_time_t* time) {
-  // A dummy implementation here for compatibility purposes.
-  // There is no clean way to produce accurate profiling data
-  // in the pure HSA API.
-  time->start = 1;
-  time->end = 2;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (phsa::Agent::fromHSAObject(agent) == nullptr)
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  phsa::Signal *S = phsa::Signal::fromHSAObject(signal);
+  if (S == nullptr)
+    return HSA_STATUS_ERROR_INVALID_SIGNAL;
+
+  if (time == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // The CPU agents run on the system timestamp, so the times need no
+  // conversion.
+  time->start = S->profilingStart();
+  time->end = S->profilingEnd();
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_profiling_get_async_copy_time(
         hsa_signal_t signal, hsa_amd_profiling_async_copy_time_t* time) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  phsa::Signal *S = phsa::Signal::fromHSAObject(signal);
+  if (S == nullptr)
+    return HSA_STATUS_ERROR_INVALID_SIGNAL;
+
+  if (time == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  time->start = S->profilingStart();
+  time->end = S->profilingEnd();
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_profiling_convert_tick_to_system_domain(hsa_agent_t agent,
                                                 uint64_t agent_tick,
                                                 uint64_t* system_tick) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (phsa::Agent::fromHSAObject(agent) == nullptr)
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  if (system_tick == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // All the agents share the system timestamp.
+  *system_tick = agent_tick;
   return HSA_STATUS_SUCCESS;
 }
 
@@ -133,12 +138,29 @@ hsa_status_t HSA_API hsa_amd_signal_async_handler(hsa_signal_t signal,
                              hsa_signal_condition_t cond,
                              hsa_signal_value_t value,
                              hsa_amd_signal_handler handler, void* arg) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  phsa::Signal *S = phsa::Signal::fromHSAObject(signal);
+  if (S == nullptr)
+    return HSA_STATUS_ERROR_INVALID_SIGNAL;
+
+  if (handler == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::Runtime::get().getAsyncEvents().addHandler(*S, cond, value, handler,
+                                                   arg);
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_async_function(void (*callback)(void* arg), void* arg) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (callback == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::Runtime::get().getAsyncEvents().addFunction(callback, arg);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -148,8 +170,19 @@ hsa_amd_signal_wait_any(uint32_t signal_count, hsa_signal_t* signals,
                         hsa_signal_value_t* values, uint64_t timeout_hint,
                         hsa_wait_state_t wait_hint,
                         hsa_signal_value_t* satisfying_value) {
-  ABORT_UNIMPLEMENTED;
-  return 0;
+  if (!phsa::Runtime::isInitialized() || signal_count == 0 ||
+      signals == nullptr || conds == nullptr || values == nullptr)
+    return phsa::Signal::NoSignal;
+
+  std::vector<phsa::Signal *> Signals(signal_count);
+  if (!phsa::Signal::fromHSAObjects(signal_count, signals, Signals.data()))
+    return phsa::Signal::NoSignal;
+
+  // The timeout is given in system timestamp ticks.
+  return phsa::Signal::waitAny(
+      signal_count, Signals.data(), conds, values,
+      phsa::Timestamp::toDuration(timeout_hint),
+      wait_hint == HSA_WAIT_STATE_BLOCKED, satisfying_value);
 }
 
 hsa_status_t HSA_API hsa_amd_image_get_info_max_dim(hsa_agent_t agent,
@@ -162,7 +195,22 @@ hsa_status_t HSA_API hsa_amd_image_get_info_max_dim(hsa_agent_t agent,
 hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                                uint32_t num_cu_mask_count,
                                                const uint32_t* cu_mask) {
-  ABORT_UNIMPLEMENTED;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (queue == nullptr)
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+
+  phsa::Queue *Q = phsa::Queue::FindQueue(queue);
+  if (Q == nullptr || Q->isDestroyed())
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+
+  if (num_cu_mask_count % 32 != 0 || cu_mask == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // The agent maps the compute units to the host cores.
+  Q->setComputeUnitMask(
+      std::vector<uint32_t>(cu_mask, cu_mask + num_cu_mask_count / 32));
   return HSA_STATUS_SUCCESS;
 }
 
@@ -170,43 +218,63 @@ hsa_status_t HSA_API
 hsa_amd_memory_pool_get_info(hsa_amd_memory_pool_t memory_pool,
                              hsa_amd_memory_pool_info_t attribute,
                              void* value) {
-  hsa_region_t region;
-  region.handle = memory_pool.handle;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  phsa::MemoryPool *Pool = phsa::MemoryPool::fromHSAObject(memory_pool);
+  if (Pool == nullptr || value == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  phsa::MemoryRegion &Region = Pool->getRegion();
 
   switch (attribute) {
   case HSA_AMD_MEMORY_POOL_INFO_SEGMENT: {
-    hsa_region_segment_t region_segment;
     hsa_amd_segment_t *segment = (hsa_amd_segment_t*)value;
-
-    HSA_CHECK_STATUS(hsa_region_get_info(region, HSA_REGION_INFO_SEGMENT,
-                                         &region_segment),
-                     "hsa_region_get_info() failed.");
-
-    if (region_segment == HSA_REGION_SEGMENT_GLOBAL)
+    switch (Region.getRegion()) {
+    case HSA_REGION_SEGMENT_GLOBAL:
       *segment = HSA_AMD_SEGMENT_GLOBAL;
-    else if (region_segment == HSA_REGION_SEGMENT_GROUP)
+      break;
+    case HSA_REGION_SEGMENT_READONLY:
+      *segment = HSA_AMD_SEGMENT_READONLY;
+      break;
+    case HSA_REGION_SEGMENT_PRIVATE:
+      *segment = HSA_AMD_SEGMENT_PRIVATE;
+      break;
+    case HSA_REGION_SEGMENT_GROUP:
       *segment = HSA_AMD_SEGMENT_GROUP;
-    else
-      ABORT_UNIMPLEMENTED;
+      break;
+    }
     break;
   }
   case HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS: {
-    hsa_amd_memory_pool_global_flag_t *flags =
-      (hsa_amd_memory_pool_global_flag_t*)value;
-    *flags = (hsa_amd_memory_pool_global_flag_t)
-      ((int)HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_FINE_GRAINED
-       | (int)HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_KERNARG_INIT);
+    uint32_t RegionFlags = Region.getGlobalFlags();
+    uint32_t flags = 0;
+    if (RegionFlags & HSA_REGION_GLOBAL_FLAG_KERNARG)
+      flags |= HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_KERNARG_INIT;
+    if (RegionFlags & HSA_REGION_GLOBAL_FLAG_FINE_GRAINED)
+      flags |= HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_FINE_GRAINED;
+    if (RegionFlags & HSA_REGION_GLOBAL_FLAG_COARSE_GRAINED)
+      flags |= HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED;
+    *(uint32_t*)value = flags;
     break;
   }
-  case HSA_AMD_MEMORY_POOL_INFO_SIZE: {
-    size_t *size = (size_t*)value;
-    HSA_CHECK_STATUS(hsa_region_get_info(region, HSA_REGION_INFO_SIZE, size),
-                     "hsa_region_get_info() failed.");
+  case HSA_AMD_MEMORY_POOL_INFO_SIZE:
+    *(size_t*)value = Region.getSize();
     break;
-  }
-  default:
-    ABORT_UNIMPLEMENTED;
+  case HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED:
+    *(bool*)value = Region.getRuntimeAllocAllowed();
+    break;
+  case HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_GRANULE:
+    *(size_t*)value = Region.getRuntimeAllocGranularity();
+    break;
+  case HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALIGNMENT:
+    *(size_t*)value = Pool->getAlignment();
     break;
+  case HSA_AMD_MEMORY_POOL_INFO_ACCESSIBLE_BY_ALL:
+    // All the agents share the host memory.
+    *(bool*)value = true;
+    break;
+  default:
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
   return HSA_STATUS_SUCCESS;
 }
@@ -215,21 +283,55 @@ hsa_status_t HSA_API hsa_amd_agent_iterate_memory_pools(
         hsa_agent_t agent,
         hsa_status_t (*callback)(hsa_amd_memory_pool_t memory_pool, void* data),
         void* data) {
-  AgentData &agentData = get_agent_data(agent);
-  for (auto mp : agentData.mem_pools)
-    callback(*mp, data);
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (callback == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::Agent *Agent = phsa::Agent::fromHSAObject(agent);
+  if (Agent == nullptr)
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  for (auto I = Agent->region_begin(), E = Agent->region_end(); I != E; ++I) {
+    phsa::MemoryPool &Pool = phsa::MemoryPool::forRegion(**I);
+    hsa_status_t Status = callback(Pool.toHSAObject(), data);
+    if (Status != HSA_STATUS_SUCCESS)
+      return Status;
+  }
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API
 hsa_amd_memory_pool_allocate(hsa_amd_memory_pool_t memory_pool, size_t size,
                              uint32_t flags, void** ptr) {
-  hsa_region_t region;
-  region.handle = memory_pool.handle;
-  return hsa_memory_allocate(region, size, ptr);
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (size == 0 || ptr == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::MemoryPool *Pool = phsa::MemoryPool::fromHSAObject(memory_pool);
+  if (Pool == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  phsa::MemoryRegion &Region = Pool->getRegion();
+  if (size > Region.getMaxAllocSize() || !Region.getRuntimeAllocAllowed())
+    return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+
+  *ptr = Pool->allocate(size);
+  return *ptr == nullptr ? HSA_STATUS_ERROR_OUT_OF_RESOURCES
+                         : HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_amd_memory_pool_free(void* ptr) {
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (ptr == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // Frees the blocks of the pools to their pool.
   return hsa_memory_free(ptr);
 }
 
@@ -239,11 +341,30 @@ hsa_amd_memory_async_copy(void* dst, hsa_agent_t dst_agent, const void* src,
                           uint32_t num_dep_signals,
                           const hsa_signal_t* dep_signals,
                           hsa_signal_t completion_signal) {
-  for (uint32_t i = 0; i < num_dep_signals; ++i)
-    hsa_signal_wait_acquire(dep_signals[i], HSA_SIGNAL_CONDITION_EQ,
-                            0, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
-  hsa_memory_copy(dst, src, size);
-  hsa_signal_store_relaxed(completion_signal, 0);
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (dst == nullptr || src == nullptr || size == 0 ||
+      (num_dep_signals > 0 && dep_signals == nullptr))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  std::vector<phsa::Signal *> Dependencies;
+  for (uint32_t i = 0; i < num_dep_signals; ++i) {
+    phsa::Signal *Dependency = phsa::Signal::fromHSAObject(dep_signals[i]);
+    if (Dependency == nullptr)
+      return HSA_STATUS_ERROR_INVALID_SIGNAL;
+    Dependencies.push_back(Dependency);
+  }
+
+  phsa::Signal *Completion = nullptr;
+  if (completion_signal.handle != 0) {
+    Completion = phsa::Signal::fromHSAObject(completion_signal);
+    if (Completion == nullptr)
+      return HSA_STATUS_ERROR_INVALID_SIGNAL;
+  }
+
+  phsa::Runtime::get().copyMemoryAsync(dst, src, size, Dependencies,
+                                       Completion);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -256,6 +377,10 @@ hsa_status_t HSA_API hsa_amd_agent_memory_pool_get_info(
       HSA_AMD_MEMORY_POOL_ACCESS_ALLOWED_BY_DEFAULT;
     break;
   }
+  case HSA_AMD_AGENT_MEMORY_POOL_INFO_NUM_LINK_HOPS:
+    // The pools are in the host memory of the agents.
+    *(uint32_t*)value = 0;
+    break;
   default:
     ABORT_UNIMPLEMENTED;
     break;
@@ -288,12 +413,28 @@ hsa_status_t HSA_API hsa_amd_memory_migrate(const void* ptr,
 hsa_status_t HSA_API hsa_amd_memory_lock(void* host_ptr, size_t size,
                                          hsa_agent_t* agents, int num_agent,
                                          void** agent_ptr) {
-  *agent_ptr = host_ptr;
-  return HSA_STATUS_SUCCESS;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (host_ptr == nullptr || size == 0 || agent_ptr == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // The agents share the host address space.
+  hsa_status_t Status =
+      phsa::Runtime::get().registerMemory(host_ptr, size, true);
+  if (Status == HSA_STATUS_SUCCESS)
+    *agent_ptr = host_ptr;
+  return Status;
 }
 
 hsa_status_t HSA_API hsa_amd_memory_unlock(void* host_ptr) {
-  return HSA_STATUS_SUCCESS;
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (host_ptr == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return phsa::Runtime::get().deregisterMemory(host_ptr);
 }
 
 hsa_status_t HSA_API
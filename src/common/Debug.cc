@@ -26,23 +26,16 @@
 
 namespace phsa {
 
-static int DebugMode = 0;
+static bool ReadDebugMode() {
+  char *DevelModeEnv = std::getenv("PHSA_DEBUG_MODE");
+  return DevelModeEnv != nullptr && std::strlen(DevelModeEnv) == 1 &&
+         DevelModeEnv[0] == '1';
+}
 
 bool IsDebugMode() {
-  if (DebugMode == 1)
-    return true;
-  else if (DebugMode == 0) {
-    char *DevelModeEnv = std::getenv("PHSA_DEBUG_MODE");
-    if (DevelModeEnv != nullptr && std::strlen(DevelModeEnv) == 1 &&
-        DevelModeEnv[0] == '1') {
-      DebugMode = 1;
-      return true;
-    } else {
-      DebugMode = 2;
-      return false;
-    }
-  }
-  return false;
+  // Initialized once in a thread safe manner.
+  static const bool DebugMode = ReadDebugMode();
+  return DebugMode;
 }
 
 } // namespace phsa
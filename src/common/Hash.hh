@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Hashing of content for content-addressed caches.
+ */
+
+#ifndef HSA_RUNTIME_HASH_HH
+#define HSA_RUNTIME_HASH_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace phsa {
+
+// Incremental 128-bit FNV-1a hash. Strings are hashed together with
+// their length so that consecutive fields cannot alias.
+class ContentHash {
+public:
+  ContentHash &add(const void *Data, std::size_t Size) {
+    const uint8_t *Bytes = static_cast<const uint8_t *>(Data);
+    for (std::size_t I = 0; I < Size; ++I) {
+      State ^= Bytes[I];
+      State *= Prime;
+    }
+    return *this;
+  }
+
+  ContentHash &add(const std::string &String) {
+    addValue(String.size());
+    return add(String.data(), String.size());
+  }
+
+  template <typename T> ContentHash &addValue(const T &Value) {
+    return add(&Value, sizeof(Value));
+  }
+
+  unsigned __int128 value() const { return State; }
+
+  // The hash as 32 hexadecimal digits.
+  std::string hex() const {
+    static const char Digits[] = "0123456789abcdef";
+    std::string Hex(32, '0');
+    unsigned __int128 Value = State;
+    for (int I = 31; I >= 0; --I) {
+      Hex[I] = Digits[Value & 0xf];
+      Value >>= 4;
+    }
+    return Hex;
+  }
+
+private:
+  static constexpr unsigned __int128 Prime =
+      (static_cast<unsigned __int128>(0x0000000001000000ull) << 64) |
+      0x000000000000013bull;
+
+  unsigned __int128 State =
+      (static_cast<unsigned __int128>(0x6c62272e07bb0142ull) << 64) |
+      0x62b821756295c58dull;
+};
+
+// 64-bit xxHash (XXH64) of the data, for checksumming large buffers at
+// memory speed.
+inline uint64_t checksum64(const void *Data, std::size_t Size,
+                           uint64_t Seed = 0) {
+  const uint64_t P1 = 11400714785074694791ull;
+  const uint64_t P2 = 14029467366897019727ull;
+  const uint64_t P3 = 1609587929392839161ull;
+  const uint64_t P4 = 9650029242287828579ull;
+  const uint64_t P5 = 2870177450012600261ull;
+  auto Rotl = [](uint64_t X, int R) { return (X << R) | (X >> (64 - R)); };
+  auto Round = [&](uint64_t Acc, uint64_t Input) {
+    return Rotl(Acc + Input * P2, 31) * P1;
+  };
+  auto Merge = [&](uint64_t Acc, uint64_t Value) {
+    return (Acc ^ Round(0, Value)) * P1 + P4;
+  };
+  auto Read64 = [](const uint8_t *P) {
+    uint64_t V;
+    std::memcpy(&V, P, sizeof(V));
+    return V;
+  };
+  auto Read32 = [](const uint8_t *P) {
+    uint32_t V;
+    std::memcpy(&V, P, sizeof(V));
+    return static_cast<uint64_t>(V);
+  };
+
+  const uint8_t *P = static_cast<const uint8_t *>(Data);
+  const uint8_t *End = P + Size;
+  uint64_t H;
+  if (Size >= 32) {
+    uint64_t V1 = Seed + P1 + P2, V2 = Seed + P2, V3 = Seed, V4 = Seed - P1;
+    for (; P + 32 <= End; P += 32) {
+      V1 = Round(V1, Read64(P));
+      V2 = Round(V2, Read64(P + 8));
+      V3 = Round(V3, Read64(P + 16));
+      V4 = Round(V4, Read64(P + 24));
+    }
+    H = Rotl(V1, 1) + Rotl(V2, 7) + Rotl(V3, 12) + Rotl(V4, 18);
+    H = Merge(Merge(Merge(Merge(H, V1), V2), V3), V4);
+  } else {
+    H = Seed + P5;
+  }
+  H += Size;
+  for (; P + 8 <= End; P += 8)
+    H = Rotl(H ^ Round(0, Read64(P)), 27) * P1 + P4;
+  if (P + 4 <= End) {
+    H = Rotl(H ^ (Read32(P) * P1), 23) * P2 + P3;
+    P += 4;
+  }
+  for (; P < End; ++P)
+    H = Rotl(H ^ (*P * P5), 11) * P1;
+  H ^= H >> 33;
+  H *= P2;
+  H ^= H >> 29;
+  H *= P3;
+  H ^= H >> 32;
+  return H;
+}
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_HASH_HH
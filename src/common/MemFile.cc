@@ -0,0 +1,69 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Anonymous in-memory files.
+ */
+
+#include "MemFile.hh"
+
+#include <cerrno>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace phsa {
+
+int createMemFile(const char *Name, const void *Data, std::size_t Size) {
+#ifdef SYS_memfd_create
+  int Fd = syscall(SYS_memfd_create, Name, MFD_CLOEXEC);
+  if (Fd == -1)
+    return -1;
+  if (!writeAll(Fd, Data, Size)) {
+    close(Fd);
+    return -1;
+  }
+  return Fd;
+#else
+  return -1;
+#endif
+}
+
+bool writeAll(int Fd, const void *Data, std::size_t Size) {
+  const char *Bytes = static_cast<const char *>(Data);
+  while (Size > 0) {
+    ssize_t Written = write(Fd, Bytes, Size);
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Bytes += Written;
+    Size -= Written;
+  }
+  return true;
+}
+
+std::string procFdPath(int Fd) {
+  return "/proc/self/fd/" + std::to_string(Fd);
+}
+
+} // namespace phsa
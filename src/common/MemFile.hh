@@ -0,0 +1,45 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Anonymous in-memory files.
+ */
+
+#ifndef HSA_RUNTIME_MEMFILE_HH
+#define HSA_RUNTIME_MEMFILE_HH
+
+#include <cstddef>
+#include <string>
+
+namespace phsa {
+
+// Creates an anonymous close-on-exec in-memory file with the given
+// contents. Returns the descriptor, or -1 in case memfd_create() is not
+// supported or the contents could not be written.
+int createMemFile(const char *Name, const void *Data, std::size_t Size);
+
+// Writes all of the data to the descriptor, retrying on interrupts and
+// partial writes.
+bool writeAll(int Fd, const void *Data, std::size_t Size);
+
+// The path through which the descriptor Fd of the process can be opened.
+std::string procFdPath(int Fd);
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_MEMFILE_HH
@@ -0,0 +1,182 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Running external programs without a shell.
+ */
+
+#include "Process.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Timestamp.hh"
+
+extern char **environ;
+
+namespace phsa {
+
+namespace {
+
+void closePipe(int Pipe[2]) {
+  for (int I = 0; I < 2; ++I) {
+    if (Pipe[I] != -1)
+      close(Pipe[I]);
+    Pipe[I] = -1;
+  }
+}
+
+} // namespace
+
+std::vector<int> childDescriptors(const std::vector<int> &Fds) {
+  // Above all the source descriptors so none of them gets overwritten
+  // before it has been duplicated.
+  int Base = STDERR_FILENO + 1;
+  for (int Fd : Fds)
+    Base = std::max(Base, Fd + 1);
+  std::vector<int> ChildFds;
+  for (size_t I = 0; I < Fds.size(); ++I)
+    ChildFds.push_back(Base + I);
+  return ChildFds;
+}
+
+std::vector<std::string> splitArguments(const std::string &CommandLine) {
+  std::vector<std::string> Arguments;
+  std::istringstream Stream(CommandLine);
+  std::string Argument;
+  while (Stream >> Argument)
+    Arguments.push_back(Argument);
+  return Arguments;
+}
+
+ProcessResult runProcess(const std::vector<std::string> &Argv,
+                         const std::vector<int> &Fds, unsigned TimeoutMs) {
+  ProcessResult Result;
+  if (Argv.empty())
+    return Result;
+
+  // Close-on-exec so that children spawned concurrently by other threads
+  // do not keep the pipes open.
+  int OutPipe[2] = {-1, -1};
+  int ErrPipe[2] = {-1, -1};
+  if (pipe2(OutPipe, O_CLOEXEC) != 0 || pipe2(ErrPipe, O_CLOEXEC) != 0) {
+    closePipe(OutPipe);
+    closePipe(ErrPipe);
+    Result.Errors = "could not create pipes";
+    return Result;
+  }
+
+  posix_spawn_file_actions_t Actions;
+  posix_spawn_file_actions_init(&Actions);
+  posix_spawn_file_actions_addopen(&Actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&Actions, OutPipe[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&Actions, ErrPipe[1], STDERR_FILENO);
+  std::vector<int> ChildFds = childDescriptors(Fds);
+  for (size_t I = 0; I < Fds.size(); ++I)
+    posix_spawn_file_actions_adddup2(&Actions, Fds[I], ChildFds[I]);
+
+  // In a process group of its own so that the compiler subprocesses can
+  // be killed along with it.
+  posix_spawnattr_t Attributes;
+  posix_spawnattr_init(&Attributes);
+  posix_spawnattr_setflags(&Attributes, POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setpgroup(&Attributes, 0);
+
+  std::vector<char *> Args;
+  for (const std::string &Arg : Argv)
+    Args.push_back(const_cast<char *>(Arg.c_str()));
+  Args.push_back(nullptr);
+
+  pid_t Pid;
+  int SpawnError = posix_spawnp(&Pid, Args[0], &Actions, &Attributes,
+                                Args.data(), environ);
+  posix_spawn_file_actions_destroy(&Actions);
+  posix_spawnattr_destroy(&Attributes);
+  close(OutPipe[1]);
+  close(ErrPipe[1]);
+
+  if (SpawnError != 0) {
+    close(OutPipe[0]);
+    close(ErrPipe[0]);
+    Result.Errors = "could not start " + Argv[0];
+    return Result;
+  }
+
+  uint64_t Deadline =
+      Timestamp::deadline(std::chrono::milliseconds(TimeoutMs));
+  struct pollfd Polled[2] = {{OutPipe[0], POLLIN, 0}, {ErrPipe[0], POLLIN, 0}};
+  std::string *Collected[2] = {&Result.Output, &Result.Errors};
+  int Open = 2;
+  while (Open > 0) {
+    int Timeout = -1;
+    if (TimeoutMs != 0 && !Result.TimedOut) {
+      uint64_t Now = Timestamp::now();
+      auto Left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          Timestamp::toDuration(Deadline > Now ? Deadline - Now : 0));
+      Timeout = Left.count();
+    }
+    int Ready = poll(Polled, 2, Timeout);
+    if (Ready < 0 && errno == EINTR)
+      continue;
+    if (Ready < 0)
+      break;
+    if (Ready == 0) {
+      Result.TimedOut = true;
+      kill(-Pid, SIGKILL);
+      continue;
+    }
+    for (int I = 0; I < 2; ++I) {
+      if (Polled[I].fd == -1 || Polled[I].revents == 0)
+        continue;
+      char Buffer[4096];
+      ssize_t Count = read(Polled[I].fd, Buffer, sizeof(Buffer));
+      if (Count < 0 && errno == EINTR)
+        continue;
+      if (Count <= 0) {
+        close(Polled[I].fd);
+        Polled[I].fd = -1;
+        --Open;
+        continue;
+      }
+      Collected[I]->append(Buffer, Count);
+    }
+  }
+  for (int I = 0; I < 2; ++I) {
+    if (Polled[I].fd != -1)
+      close(Polled[I].fd);
+  }
+
+  int Status = 0;
+  pid_t Waited;
+  while ((Waited = waitpid(Pid, &Status, 0)) == -1 && errno == EINTR)
+    ;
+  if (Waited == Pid && WIFEXITED(Status))
+    Result.ExitStatus = WEXITSTATUS(Status);
+  return Result;
+}
+
+} // namespace phsa
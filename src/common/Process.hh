@@ -0,0 +1,63 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * Running external programs without a shell.
+ */
+
+#ifndef HSA_RUNTIME_PROCESS_HH
+#define HSA_RUNTIME_PROCESS_HH
+
+#include <string>
+#include <vector>
+
+namespace phsa {
+
+// The outcome of running a child process.
+struct ProcessResult {
+  // The exit status, or -1 in case the process could not be started or
+  // was terminated by a signal.
+  int ExitStatus = -1;
+  bool TimedOut = false;
+  std::string Output;
+  std::string Errors;
+
+  bool succeeded() const { return ExitStatus == 0 && !TimedOut; }
+};
+
+// Runs the program Argv[0], searched from PATH, with posix_spawn() and
+// collects its standard output and error. The descriptors Fds of the
+// calling process are made available to the child under the numbers
+// returned by childDescriptors(Fds). The whole process group of the
+// child is killed in case it does not finish in TimeoutMs milliseconds.
+// Zero means no timeout.
+ProcessResult runProcess(const std::vector<std::string> &Argv,
+                         const std::vector<int> &Fds = std::vector<int>(),
+                         unsigned TimeoutMs = 0);
+
+// The descriptor numbers the descriptors Fds get in a child started with
+// runProcess().
+std::vector<int> childDescriptors(const std::vector<int> &Fds);
+
+// Splits a command line to arguments at white space. Quoting is not
+// supported.
+std::vector<std::string> splitArguments(const std::string &CommandLine);
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_PROCESS_HH
@@ -0,0 +1,124 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A fixed size pool of host worker threads.
+ */
+
+#include "ThreadPool.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace phsa {
+
+namespace {
+// The pool the calling thread belongs to, if any.
+thread_local const ThreadPool *CurrentPool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned ThreadCount) {
+  for (unsigned I = 0; I < ThreadCount; ++I)
+    Threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> L(TasksLock);
+    ShuttingDown = true;
+  }
+  TasksAvailable.notify_all();
+  for (auto &T : Threads)
+    T.join();
+}
+
+void ThreadPool::submit(Task T) {
+  {
+    std::lock_guard<std::mutex> L(TasksLock);
+    Tasks.push_back(std::move(T));
+  }
+  TasksAvailable.notify_one();
+}
+
+bool ThreadPool::isPoolThread() const { return CurrentPool == this; }
+
+void ThreadPool::work() {
+  CurrentPool = this;
+  while (true) {
+    Task T;
+    {
+      std::unique_lock<std::mutex> L(TasksLock);
+      TasksAvailable.wait(L, [this]() { return ShuttingDown || !Tasks.empty(); });
+      if (Tasks.empty())
+        return;
+      T = std::move(Tasks.front());
+      Tasks.pop_front();
+    }
+    T();
+  }
+}
+
+void ThreadPool::parallelFor(std::size_t Count,
+                             std::function<void(std::size_t)> Body) {
+  if (Count <= 1 || Threads.empty() || isPoolThread()) {
+    for (std::size_t I = 0; I < Count; ++I)
+      Body(I);
+    return;
+  }
+
+  std::atomic<std::size_t> NextIndex(0);
+  auto RunIterations = [&]() {
+    std::size_t I;
+    while ((I = NextIndex.fetch_add(1)) < Count)
+      Body(I);
+  };
+
+  // The helpers refer to the state in this stack frame, thus all of them
+  // must have finished before returning, even the ones that found no work.
+  std::size_t Helpers = std::min<std::size_t>(Count - 1, Threads.size());
+  std::size_t RunningHelpers = Helpers;
+  std::mutex HelpersLock;
+  std::condition_variable HelpersDone;
+  for (std::size_t H = 0; H < Helpers; ++H) {
+    submit([&]() {
+      RunIterations();
+      std::lock_guard<std::mutex> L(HelpersLock);
+      if (--RunningHelpers == 0)
+        HelpersDone.notify_one();
+    });
+  }
+
+  RunIterations();
+
+  std::unique_lock<std::mutex> L(HelpersLock);
+  HelpersDone.wait(L, [&]() { return RunningHelpers == 0; });
+}
+
+unsigned ThreadPool::threadCountFromEnvironment(const char *Name) {
+  const char *CountEnv = std::getenv(Name);
+  if (CountEnv != nullptr) {
+    int Count = std::atoi(CountEnv);
+    if (Count >= 0)
+      return Count;
+  }
+  unsigned HWThreads = std::thread::hardware_concurrency();
+  return HWThreads > 0 ? HWThreads : 1;
+}
+
+} // namespace phsa
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * A fixed size pool of host worker threads.
+ */
+
+#ifndef HSA_RUNTIME_THREADPOOL_HH
+#define HSA_RUNTIME_THREADPOOL_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace phsa {
+
+// Executes submitted tasks in FIFO order in a fixed set of threads.
+// The destructor finishes the already submitted tasks before joining
+// the threads.
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  ThreadPool(unsigned ThreadCount);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  void submit(Task T);
+
+  // Calls Body for indices [0, Count) using the pool threads and the
+  // calling thread. Returns once all the calls have returned. Runs
+  // serially in the calling thread in case it's a thread of this pool
+  // to avoid waiting for itself.
+  void parallelFor(std::size_t Count, std::function<void(std::size_t)> Body);
+
+  unsigned threadCount() const { return Threads.size(); }
+
+  // Returns true in case the calling thread belongs to this pool.
+  bool isPoolThread() const;
+
+  // The thread count requested with the environment variable Name, or
+  // the number of hardware threads if not set.
+  static unsigned threadCountFromEnvironment(const char *Name);
+
+private:
+  void work();
+
+  std::vector<std::thread> Threads;
+  std::deque<Task> Tasks;
+  std::mutex TasksLock;
+  std::condition_variable TasksAvailable;
+  bool ShuttingDown = false;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_THREADPOOL_HH
@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The system timestamp shared by the runtime.
+ */
+
+#include "Timestamp.hh"
+
+#include <fstream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace phsa {
+
+namespace {
+
+// How long the counter is compared against CLOCK_MONOTONIC_RAW in case
+// its frequency is not reported by the processor.
+const uint64_t CalibrationNanoseconds = 10000000;
+// The number of paired readings taken at both ends of the calibration.
+// The pair read in the shortest window is the most accurate one.
+const int CalibrationSamples = 16;
+
+bool hasInvariantTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned EAX, EBX, ECX, EDX;
+  if (__get_cpuid(0x80000000, &EAX, &EBX, &ECX, &EDX) == 0 ||
+      EAX < 0x80000007)
+    return false;
+  __get_cpuid(0x80000007, &EAX, &EBX, &ECX, &EDX);
+  // The counter runs at a constant rate in all the ACPI P-, C- and
+  // T-states.
+  return (EDX & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+// The kernel falls back to another clock source in case it finds the
+// counters of the cores out of sync, so a kernel using the counter
+// guarantees it is monotonic across the cores.
+bool kernelTrustsTSC() {
+  std::ifstream Source(
+      "/sys/devices/system/clocksource/clocksource0/current_clocksource");
+  std::string Name;
+  return Source >> Name && Name == "tsc";
+}
+
+// The counter frequency reported by the processor, or 0 if unknown.
+uint64_t reportedTSCFrequency() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned EAX, EBX, ECX, EDX;
+  if (__get_cpuid_max(0, nullptr) < 0x15)
+    return 0;
+  __cpuid_count(0x15, 0, EAX, EBX, ECX, EDX);
+  // The ratio of the counter to the core crystal clock and the crystal
+  // frequency.
+  if (EAX == 0 || EBX == 0 || ECX == 0)
+    return 0;
+  return (uint64_t)ECX * EBX / EAX;
+#else
+  return 0;
+#endif
+}
+
+struct Reading {
+  uint64_t Nanoseconds;
+  uint64_t Ticks;
+};
+
+// Reads the counter between two CLOCK_MONOTONIC_RAW readings and keeps
+// the pair with the shortest window in between.
+Reading readPair() {
+  Reading Best = {0, 0};
+  uint64_t BestWindow = std::numeric_limits<uint64_t>::max();
+  for (int I = 0; I < CalibrationSamples; ++I) {
+    timespec Before, After;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Before);
+    uint64_t Ticks = Timestamp::now();
+    clock_gettime(CLOCK_MONOTONIC_RAW, &After);
+    uint64_t B = (uint64_t)Before.tv_sec * 1000000000 + Before.tv_nsec;
+    uint64_t A = (uint64_t)After.tv_sec * 1000000000 + After.tv_nsec;
+    if (A - B < BestWindow) {
+      BestWindow = A - B;
+      Best = Reading{B + (A - B) / 2, Ticks};
+    }
+  }
+  return Best;
+}
+
+uint64_t calibrateTSCFrequency() {
+  uint64_t Reported = reportedTSCFrequency();
+  if (Reported != 0)
+    return Reported;
+
+  Reading Start = readPair();
+  timespec Pause = {0, (long)CalibrationNanoseconds};
+  while (nanosleep(&Pause, &Pause) != 0) {
+  }
+  Reading End = readPair();
+  return (End.Ticks - Start.Ticks) * 1000000000.0 /
+         (End.Nanoseconds - Start.Nanoseconds);
+}
+
+} // namespace
+
+const bool Timestamp::UseTSC = hasInvariantTSC() && kernelTrustsTSC();
+
+const Timestamp::Calibration &Timestamp::calibration() {
+  static const Calibration C = []() {
+    uint64_t Frequency = UseTSC ? calibrateTSCFrequency() : 1000000000;
+    return Calibration{Frequency, Frequency / 1e9};
+  }();
+  return C;
+}
+
+uint64_t Timestamp::fromDuration(std::chrono::nanoseconds Duration) {
+  if (Duration.count() <= 0)
+    return 0;
+  double Ticks = Duration.count() * calibration().TicksPerNanosecond;
+  if (Ticks >= (double)std::numeric_limits<uint64_t>::max())
+    return std::numeric_limits<uint64_t>::max();
+  return Ticks;
+}
+
+std::chrono::nanoseconds Timestamp::toDuration(uint64_t Ticks) {
+  double Nanoseconds = Ticks / calibration().TicksPerNanosecond;
+  if (Nanoseconds >= (double)std::chrono::nanoseconds::max().count())
+    return std::chrono::nanoseconds::max();
+  return std::chrono::nanoseconds((std::chrono::nanoseconds::rep)Nanoseconds);
+}
+
+} // namespace phsa
@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2016 General Processor Tech.
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+/**
+ * The system timestamp shared by the runtime.
+ */
+
+#ifndef HSA_RUNTIME_TIMESTAMP_HH
+#define HSA_RUNTIME_TIMESTAMP_HH
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace phsa {
+
+// The clock of the runtime. Reported by HSA_SYSTEM_INFO_TIMESTAMP, recorded
+// to the dispatch and copy profiling data and used for measuring the
+// timeouts of the waits, which HSA gives in timestamp ticks. The agents
+// share the system timestamp, so agent ticks need no conversion.
+//
+// Reads the invariant time stamp counter when the kernel has verified it
+// to be synchronized across the cores, otherwise CLOCK_MONOTONIC_RAW
+// nanoseconds. Both are monotonic across cores and read without a system
+// call. The counter frequency comes from CPUID when the processor reports
+// it and is calibrated against CLOCK_MONOTONIC_RAW otherwise.
+class Timestamp {
+public:
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (UseTSC)
+      return __rdtsc();
+#endif
+    return monotonicNanoseconds();
+  }
+
+  // The number of ticks per second.
+  static uint64_t frequency() { return calibration().Frequency; }
+
+  // Converts between ticks and durations. Saturates instead of
+  // overflowing.
+  static uint64_t fromDuration(std::chrono::nanoseconds Duration);
+  static std::chrono::nanoseconds toDuration(uint64_t Ticks);
+
+  // The timestamp at which Timeout from now passes.
+  static uint64_t deadline(std::chrono::nanoseconds Timeout) {
+    uint64_t Now = now();
+    uint64_t Ticks = fromDuration(Timeout);
+    if (Ticks > std::numeric_limits<uint64_t>::max() - Now)
+      return std::numeric_limits<uint64_t>::max();
+    return Now + Ticks;
+  }
+
+  // True in case the invariant time stamp counter is used.
+  static bool usesTSC() { return UseTSC; }
+
+private:
+  struct Calibration {
+    uint64_t Frequency;
+    double TicksPerNanosecond;
+  };
+
+  static uint64_t monotonicNanoseconds() {
+#ifdef CLOCK_MONOTONIC_RAW
+    timespec Now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static const Calibration &calibration();
+
+  static const bool UseTSC;
+};
+
+} // namespace phsa
+
+#endif // HSA_RUNTIME_TIMESTAMP_HH
@@ -24,8 +24,10 @@
 
 #include "hsa.h"
 #include "hsa_ext_amd.h"
+#include "hsa_ext_image.h"
 
 #include "Agent.hh"
+#include "Devices/CPU/CPUImage.hh"
 #include "common/Info.hh"
 #include "common/Logging.hh"
 #include "Runtime.hh"
@@ -181,6 +183,39 @@ hsa_status_t HSA_API hsa_agent_get_info(hsa_agent_t agent,
     WriteField(value, A->getComputeUnitCount());
     break;
   }
+  case HSA_EXT_AGENT_INFO_IMAGE_1D_MAX_ELEMENTS:
+  case HSA_EXT_AGENT_INFO_IMAGE_1DA_MAX_ELEMENTS: {
+    WriteField(value, uint32_t(phsa::CPUImage::Max1DWidth));
+    break;
+  }
+  case HSA_EXT_AGENT_INFO_IMAGE_1DB_MAX_ELEMENTS: {
+    WriteField(value, uint32_t(phsa::CPUImage::Max1DBWidth));
+    break;
+  }
+  case HSA_EXT_AGENT_INFO_IMAGE_2D_MAX_ELEMENTS:
+  case HSA_EXT_AGENT_INFO_IMAGE_2DA_MAX_ELEMENTS:
+  case HSA_EXT_AGENT_INFO_IMAGE_2DDEPTH_MAX_ELEMENTS:
+  case HSA_EXT_AGENT_INFO_IMAGE_2DADEPTH_MAX_ELEMENTS: {
+    WriteField(value, std::array<uint32_t, 2>{{phsa::CPUImage::Max2DSize,
+                                               phsa::CPUImage::Max2DSize}});
+    break;
+  }
+  case HSA_EXT_AGENT_INFO_IMAGE_3D_MAX_ELEMENTS: {
+    WriteField(value, std::array<uint32_t, 3>{{phsa::CPUImage::Max3DSize,
+                                               phsa::CPUImage::Max3DSize,
+                                               phsa::CPUImage::Max3DSize}});
+    break;
+  }
+  case HSA_EXT_AGENT_INFO_IMAGE_ARRAY_MAX_LAYERS: {
+    WriteField(value, uint32_t(phsa::CPUImage::MaxLayers));
+    break;
+  }
+  case HSA_EXT_AGENT_INFO_MAX_IMAGE_RD_HANDLES:
+  case HSA_EXT_AGENT_INFO_MAX_IMAGE_RORW_HANDLES:
+  case HSA_EXT_AGENT_INFO_MAX_SAMPLER_HANDLERS: {
+    WriteField(value, uint32_t(phsa::CPUImage::MaxHandles));
+    break;
+  }
   default:
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
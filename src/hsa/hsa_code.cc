@@ -22,6 +22,10 @@
  *         for General Processor Tech.
  */
 
+#include <cstring>
+#include <sstream>
+#include <string>
+
 #include "common/Info.hh"
 #include "hsa.h"
 #include "Finalizer/GCC/DLFinalizedProgram.hh"
@@ -53,16 +57,17 @@ hsa_status_t HSA_API hsa_code_object_serialize(
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
-  std::size_t Size = FP->serializedSize();
+  std::vector<uint8_t> Serialized = FP->serialize();
 
   hsa_status_t Status =
-      alloc_callback(Size, callback_data, serialized_code_object);
+      alloc_callback(Serialized.size(), callback_data, serialized_code_object);
 
   if (Status != HSA_STATUS_SUCCESS) {
     return Status;
   }
 
-  FP->serializeTo(reinterpret_cast<uint8_t *>(*serialized_code_object));
+  std::memcpy(*serialized_code_object, Serialized.data(), Serialized.size());
+  *serialized_code_object_size = Serialized.size();
 
   return HSA_STATUS_SUCCESS;
 }
@@ -78,9 +83,24 @@ hsa_status_t HSA_API hsa_code_object_deserialize(
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
+  // With the -phsa_zero-copy option the code object uses the ELF binary in
+  // the buffer directly, so the buffer must outlive it.
+  bool ReferenceBuffer = false;
+  if (options != nullptr) {
+    std::stringstream OptionStream(options);
+    std::string Option;
+    while (OptionStream >> Option) {
+      if (Option == "-phsa_zero-copy")
+        ReferenceBuffer = true;
+    }
+  }
+
   // TODO: For now, only support deserialization of DLFinalizedProgram
   phsa::DLFinalizedProgram *FP = phsa::DLFinalizedProgram::deserialize(
-      reinterpret_cast<uint8_t *>(serialized_code_object));
+      reinterpret_cast<const uint8_t *>(serialized_code_object),
+      serialized_code_object_size, ReferenceBuffer);
+  if (FP == nullptr)
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
 
   *code_object = FP->toHSAObject();
 
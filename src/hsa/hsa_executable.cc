@@ -232,19 +232,11 @@ hsa_status_t HSA_API hsa_executable_get_symbol(
   }
 
   // It is not clear whether the symbol names are supposed to include the
-  // leading '&' or not. Let's prepare for both ways as some clients seem
+  // leading '&' or not. The lookup accepts both ways as some clients seem
   // to include it, some not.
-  std::string SymbolName = symbol_name;
-  if (SymbolName[0] != '&')
-    SymbolName = std::string("&") + SymbolName;
-
-  if (module_name != nullptr && std::strlen(module_name) > 0) {
-    SymbolName.insert(1, std::string(module_name).substr(1) + ".");
-    SymbolName.insert(1, "gccbrig.");
-  }
-
   phsa::Executable *E = phsa::Executable::fromHSAObject(executable);
-  const phsa::Symbol *S = E->getSymbol(SymbolName);
+  const phsa::Symbol *S =
+      E->getSymbol(symbol_name, module_name != nullptr ? module_name : "");
   if (S == nullptr) {
     return HSA_STATUS_ERROR_INVALID_SYMBOL_NAME;
   }
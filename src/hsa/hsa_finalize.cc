@@ -22,6 +22,7 @@
 
 #include <common/Info.hh>
 #include "hsa_ext_finalize.h"
+#include "hsa_ext_phsa.h"
 
 #include "Finalizer.hh"
 #include "HSAObjectMapping.hh"
@@ -30,6 +31,8 @@
 #include "HSAILProgram.hh"
 #include "Brig.h"
 #include "FinalizedProgram.hh"
+#include "Finalizer/GCC/CodeBundle.hh"
+#include "Signal.hh"
 
 using phsa::WriteField;
 
@@ -256,3 +259,170 @@ hsa_status_t HSA_API hsa_ext_program_finalize(
       F->finalizeProgram(program, control_directives, isa, options);
   return Ret;
 }
+
+hsa_status_t HSA_API hsa_ext_phsa_program_finalize_batch(
+    uint32_t program_count, const hsa_ext_program_t *programs, hsa_isa_t isa,
+    int32_t call_convention, hsa_ext_control_directives_t control_directives,
+    const char *options, hsa_code_object_type_t code_object_type,
+    hsa_code_object_t *code_objects, hsa_status_t *statuses) {
+
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  if (programs == nullptr || code_objects == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (ISA::fromHSAObject(isa).empty()) {
+    return HSA_STATUS_ERROR_INVALID_ISA;
+  }
+
+  std::vector<hsa_ext_program_t> Programs(programs, programs + program_count);
+  for (hsa_ext_program_t Program : Programs) {
+    if (Program.handle == 0) {
+      return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+    }
+  }
+
+  Finalizer *F = getFinalizer();
+  auto Results =
+      F->finalizePrograms(Programs, control_directives, isa, options);
+
+  hsa_status_t Ret = HSA_STATUS_SUCCESS;
+  for (size_t I = 0; I < Results.size(); ++I) {
+    hsa_status_t Status;
+    std::tie(Status, code_objects[I]) = Results[I];
+    if (statuses != nullptr)
+      statuses[I] = Status;
+    if (Ret == HSA_STATUS_SUCCESS)
+      Ret = Status;
+  }
+  return Ret;
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_program_finalize_async(
+    hsa_ext_program_t program, hsa_isa_t isa, int32_t call_convention,
+    hsa_ext_control_directives_t control_directives, const char *options,
+    hsa_code_object_type_t code_object_type, hsa_code_object_t *code_object,
+    hsa_status_t *status, hsa_signal_t completion_signal) {
+
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  if (code_object == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (ISA::fromHSAObject(isa).empty()) {
+    return HSA_STATUS_ERROR_INVALID_ISA;
+  }
+
+  if (program.handle == 0) {
+    return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+  }
+
+  phsa::Signal *Completion = phsa::Signal::fromHSAObject(completion_signal);
+  if (Completion == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_SIGNAL;
+  }
+
+  getFinalizer()->finalizeProgramAsync(
+      program, control_directives, isa, options != nullptr ? options : "",
+      [=](HSAReturnValue<hsa_code_object_s> Result) {
+        hsa_status_t Status;
+        std::tie(Status, *code_object) = Result;
+        if (status != nullptr)
+          *status = Status;
+        Completion->subtract(1, phsa::MemoryOrder::Release);
+      });
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API
+hsa_ext_phsa_set_finalizer_thread_count(uint32_t thread_count) {
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  getFinalizer()->setThreadCount(thread_count);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_create(
+    const char *path, uint32_t count, const hsa_ext_program_t *programs,
+    hsa_isa_t isa, const hsa_code_object_t *code_objects) {
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  if (path == nullptr || programs == nullptr || code_objects == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (ISA::fromHSAObject(isa).empty()) {
+    return HSA_STATUS_ERROR_INVALID_ISA;
+  }
+
+  std::vector<phsa::CodeBundle::Entry> Entries(count);
+  for (uint32_t I = 0; I < count; ++I) {
+    phsa::HSAILProgram *P = phsa::HSAILProgram::fromHSAObject(programs[I]);
+    if (P == nullptr) {
+      return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+    }
+    phsa::FinalizedProgram *FP =
+        phsa::FinalizedProgram::fromHSAObject(code_objects[I]);
+    if (FP == nullptr) {
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    }
+    Entries[I].EntryTags = phsa::CodeBundle::tagsOf(*P, isa);
+    Entries[I].CodeObject = FP->serialize();
+  }
+
+  return phsa::CodeBundle::write(path, Entries) ? HSA_STATUS_SUCCESS
+                                                : HSA_STATUS_ERROR;
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_load(const char *path) {
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  if (path == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  return phsa::CodeBundle::load(path) ? HSA_STATUS_SUCCESS
+                                      : HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_code_bundle_find(
+    hsa_ext_program_t program, hsa_isa_t isa,
+    const void **serialized_code_object, size_t *serialized_code_object_size) {
+  if (!phsa::Runtime::isInitialized()) {
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+  }
+
+  if (serialized_code_object == nullptr ||
+      serialized_code_object_size == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (ISA::fromHSAObject(isa).empty()) {
+    return HSA_STATUS_ERROR_INVALID_ISA;
+  }
+
+  phsa::HSAILProgram *P = phsa::HSAILProgram::fromHSAObject(program);
+  if (P == nullptr) {
+    return static_cast<hsa_status_t>(HSA_EXT_STATUS_ERROR_INVALID_PROGRAM);
+  }
+
+  const uint8_t *CodeObject = phsa::CodeBundle::findLoaded(
+      phsa::CodeBundle::tagsOf(*P, isa), *serialized_code_object_size);
+  if (CodeObject == nullptr) {
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+  *serialized_code_object = CodeObject;
+  return HSA_STATUS_SUCCESS;
+}
@@ -21,10 +21,71 @@
  */
 
 #include "hsa_ext_image.h"
+#include "hsa_ext_phsa.h"
+
+#include "Agent.hh"
+#include "Runtime.hh"
+#include "Devices/CPU/CPUImage.hh"
+#include "Devices/CPU/ImageFormat.hh"
+
+using phsa::CPUImage;
+using phsa::CPUSampler;
+
+namespace {
+
+hsa_status_t checkAgent(hsa_agent_t agent) {
+  if (!phsa::Runtime::isInitialized())
+    return HSA_STATUS_ERROR_NOT_INITIALIZED;
+
+  if (phsa::Agent::fromHSAObject(agent) == nullptr)
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+
+  return HSA_STATUS_SUCCESS;
+}
+
+bool isValidPermission(hsa_access_permission_t access_permission) {
+  return access_permission == HSA_ACCESS_PERMISSION_RO ||
+         access_permission == HSA_ACCESS_PERMISSION_WO ||
+         access_permission == HSA_ACCESS_PERMISSION_RW;
+}
+
+// The linear order of an sRGB order, the order itself otherwise.
+hsa_ext_image_channel_order_t linearOrder(hsa_ext_image_channel_order_t Order) {
+  switch (Order) {
+  case HSA_EXT_IMAGE_CHANNEL_ORDER_SRGB:
+    return HSA_EXT_IMAGE_CHANNEL_ORDER_RGB;
+  case HSA_EXT_IMAGE_CHANNEL_ORDER_SRGBX:
+    return HSA_EXT_IMAGE_CHANNEL_ORDER_RGBX;
+  case HSA_EXT_IMAGE_CHANNEL_ORDER_SRGBA:
+    return HSA_EXT_IMAGE_CHANNEL_ORDER_RGBA;
+  case HSA_EXT_IMAGE_CHANNEL_ORDER_SBGRA:
+    return HSA_EXT_IMAGE_CHANNEL_ORDER_BGRA;
+  default:
+    return Order;
+  }
+}
+
+// Images can be copied between the same formats, and between an sRGB
+// format and its linear form.
+bool canCopyImage(const hsa_ext_image_format_t &Src,
+                  const hsa_ext_image_format_t &Dst) {
+  return Src.channel_type == Dst.channel_type &&
+         linearOrder(Src.channel_order) == linearOrder(Dst.channel_order);
+}
+
+} // namespace
 
 hsa_status_t HSA_API hsa_ext_image_get_capability(
     hsa_agent_t agent, hsa_ext_image_geometry_t geometry,
     const hsa_ext_image_format_t *image_format, uint32_t *capability_mask) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  if (image_format == nullptr || capability_mask == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  *capability_mask = phsa::imageFormatCapability(geometry, *image_format);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -32,17 +93,58 @@ hsa_status_t HSA_API hsa_ext_image_data_get_info(
     hsa_agent_t agent, const hsa_ext_image_descriptor_t *image_descriptor,
     hsa_access_permission_t access_permission,
     hsa_ext_image_data_info_t *image_data_info) {
-  return HSA_STATUS_SUCCESS;
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  if (image_descriptor == nullptr || image_data_info == nullptr ||
+      !isValidPermission(access_permission))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // The layout does not depend on the access permission.
+  return CPUImage::dataInfo(*image_descriptor, *image_data_info);
 }
+
 hsa_status_t HSA_API hsa_ext_image_create(
     hsa_agent_t agent, const hsa_ext_image_descriptor_t *image_descriptor,
     const void *image_data, hsa_access_permission_t access_permission,
     hsa_ext_image_t *image) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  if (image_descriptor == nullptr || image_data == nullptr ||
+      image == nullptr || !isValidPermission(access_permission))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  hsa_ext_image_data_info_t Info;
+  Status = CPUImage::dataInfo(*image_descriptor, Info);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  uint32_t Capability = phsa::imageFormatCapability(
+      image_descriptor->geometry, image_descriptor->format);
+  if (access_permission != HSA_ACCESS_PERMISSION_RO &&
+      !(Capability & HSA_EXT_IMAGE_CAPABILITY_WRITE_ONLY))
+    return (hsa_status_t)HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED;
+
+  CPUImage *I =
+      new CPUImage(*image_descriptor, const_cast<void *>(image_data));
+  *image = I->toHSAObject();
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_ext_image_destroy(hsa_agent_t agent,
                                            hsa_ext_image_t image) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(image);
+  if (I == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  delete I;
   return HSA_STATUS_SUCCESS;
 }
 
@@ -52,36 +154,138 @@ hsa_status_t HSA_API hsa_ext_image_copy(hsa_agent_t agent,
                                         hsa_ext_image_t dst_image,
                                         const hsa_dim3_t *dst_offset,
                                         const hsa_dim3_t *range) {
-  return HSA_STATUS_SUCCESS;
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *Src = CPUImage::fromHSAObject(src_image);
+  CPUImage *Dst = CPUImage::fromHSAObject(dst_image);
+  if (Src == nullptr || Dst == nullptr || src_offset == nullptr ||
+      dst_offset == nullptr || range == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  // The elements are copied as they are, which also covers the allowed
+  // copies between the sRGB and the linear orders. The geometries may
+  // differ as long as the region is within both of the images.
+  if (!canCopyImage(Src->descriptor().format, Dst->descriptor().format))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return Dst->copyFrom(*Src, *src_offset, *dst_offset, *range);
 }
 
 hsa_status_t HSA_API hsa_ext_image_import(
     hsa_agent_t agent, const void *src_memory, size_t src_row_pitch,
     size_t src_slice_pitch, hsa_ext_image_t dst_image,
     const hsa_ext_image_region_t *image_region) {
-  return HSA_STATUS_SUCCESS;
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(dst_image);
+  if (I == nullptr || src_memory == nullptr || image_region == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return I->import(src_memory, I->descriptor().format, src_row_pitch,
+                   src_slice_pitch, *image_region);
 }
 
 hsa_status_t HSA_API hsa_ext_image_export(
     hsa_agent_t agent, hsa_ext_image_t src_image, void *dst_memory,
     size_t dst_row_pitch, size_t dst_slice_pitch,
     const hsa_ext_image_region_t *image_region) {
-  return HSA_STATUS_SUCCESS;
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(src_image);
+  if (I == nullptr || dst_memory == nullptr || image_region == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return I->exportTo(dst_memory, I->descriptor().format, dst_row_pitch,
+                     dst_slice_pitch, *image_region);
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_image_import(
+    hsa_agent_t agent, const void *src_memory,
+    const hsa_ext_image_format_t *src_format, size_t src_row_pitch,
+    size_t src_slice_pitch, hsa_ext_image_t dst_image,
+    const hsa_ext_image_region_t *image_region) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(dst_image);
+  if (I == nullptr || src_memory == nullptr || src_format == nullptr ||
+      image_region == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  if (!phsa::canConvertImageElements(I->descriptor().format, *src_format))
+    return (hsa_status_t)HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED;
+
+  return I->import(src_memory, *src_format, src_row_pitch, src_slice_pitch,
+                   *image_region);
+}
+
+hsa_status_t HSA_API hsa_ext_phsa_image_export(
+    hsa_agent_t agent, hsa_ext_image_t src_image, void *dst_memory,
+    const hsa_ext_image_format_t *dst_format, size_t dst_row_pitch,
+    size_t dst_slice_pitch, const hsa_ext_image_region_t *image_region) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(src_image);
+  if (I == nullptr || dst_memory == nullptr || dst_format == nullptr ||
+      image_region == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  if (!phsa::canConvertImageElements(*dst_format, I->descriptor().format))
+    return (hsa_status_t)HSA_EXT_STATUS_ERROR_IMAGE_FORMAT_UNSUPPORTED;
+
+  return I->exportTo(dst_memory, *dst_format, dst_row_pitch, dst_slice_pitch,
+                     *image_region);
 }
 
 hsa_status_t HSA_API
 hsa_ext_image_clear(hsa_agent_t agent, hsa_ext_image_t image, const void *data,
                     const hsa_ext_image_region_t *image_region) {
-  return HSA_STATUS_SUCCESS;
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUImage *I = CPUImage::fromHSAObject(image);
+  if (I == nullptr || data == nullptr || image_region == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  return I->clear(data, *image_region);
 }
 
 hsa_status_t HSA_API hsa_ext_sampler_create(
     hsa_agent_t agent, const hsa_ext_sampler_descriptor_t *sampler_descriptor,
     hsa_ext_sampler_t *sampler) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  if (sampler_descriptor == nullptr || sampler == nullptr ||
+      !CPUSampler::isValid(*sampler_descriptor))
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  CPUSampler *S = new CPUSampler(*sampler_descriptor);
+  *sampler = S->toHSAObject();
   return HSA_STATUS_SUCCESS;
 }
 
 hsa_status_t HSA_API hsa_ext_sampler_destroy(hsa_agent_t agent,
                                              hsa_ext_sampler_t sampler) {
+  hsa_status_t Status = checkAgent(agent);
+  if (Status != HSA_STATUS_SUCCESS)
+    return Status;
+
+  CPUSampler *S = CPUSampler::fromHSAObject(sampler);
+  if (S == nullptr)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  delete S;
   return HSA_STATUS_SUCCESS;
 }
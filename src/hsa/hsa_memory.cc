@@ -24,6 +24,7 @@
 #include "hsa.h"
 #include <cstring>
 #include "MemoryRegion.hh"
+#include "amd/MemoryPool.hh"
 #include "common/Logging.hh"
 #include "Runtime.hh"
 
@@ -65,6 +66,11 @@ hsa_status_t HSA_API hsa_memory_free(void *Ptr) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
+  // The blocks of the memory pools go back to their pool, which would
+  // otherwise keep tracking them as allocated.
+  if (phsa::MemoryPool::freeFromAnyPool(Ptr))
+    return HSA_STATUS_SUCCESS;
+
   phsa::Runtime &RT = phsa::Runtime::get();
   RT.freePointer(Ptr);
 
@@ -80,7 +86,7 @@ hsa_status_t HSA_API hsa_memory_copy(void *dst, const void *src, size_t size) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
-  memmove(dst, src, size);
+  phsa::Runtime::get().copyMemory(dst, src, size);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -99,7 +105,7 @@ hsa_status_t HSA_API hsa_memory_register(void *ptr, size_t size) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
-  return HSA_STATUS_SUCCESS;
+  return phsa::Runtime::get().registerMemory(ptr, size, false);
 }
 
 hsa_status_t HSA_API hsa_memory_deregister(void *ptr, size_t size) {
@@ -111,5 +117,5 @@ hsa_status_t HSA_API hsa_memory_deregister(void *ptr, size_t size) {
     return HSA_STATUS_ERROR_INVALID_ARGUMENT;
   }
 
-  return HSA_STATUS_SUCCESS;
+  return phsa::Runtime::get().deregisterMemory(ptr);
 }
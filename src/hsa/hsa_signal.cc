@@ -23,6 +23,7 @@
 
 #include "hsa.h"
 #include "common/Logging.hh"
+#include "common/Timestamp.hh"
 #include "Runtime.hh"
 #include "Signal.hh"
 
@@ -283,11 +284,10 @@ phsa::Signal::UnaryPredicate ToPredicate(hsa_signal_condition_t condition,
 }
 
 std::chrono::high_resolution_clock::duration ToStdPeriod(uint64_t Timeout) {
-  if (Timeout == std::numeric_limits<uint64_t>::max()) {
-    return std::chrono::high_resolution_clock::duration::max();
-  }
-
-  return std::chrono::high_resolution_clock::duration(Timeout);
+  // The timeouts are given in system timestamp ticks.
+  return std::chrono::duration_cast<
+      std::chrono::high_resolution_clock::duration>(
+      phsa::Timestamp::toDuration(Timeout));
 }
 }
 
@@ -22,9 +22,9 @@
 
 #include "hsa.h"
 #include "Runtime.hh"
+#include "common/Timestamp.hh"
 
 #include <algorithm>
-#include <chrono>
 #include <limits>
 
 hsa_status_t HSA_API hsa_system_get_info(hsa_system_info_t attribute,
@@ -49,13 +49,11 @@ hsa_status_t HSA_API hsa_system_get_info(hsa_system_info_t attribute,
     break;
   }
   case HSA_SYSTEM_INFO_TIMESTAMP: {
-    *(uint64_t *)value = static_cast<uint64_t>(
-        std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    *(uint64_t *)value = phsa::Timestamp::now();
     break;
   }
   case HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY: {
-    *(uint64_t *)value =
-        static_cast<uint64_t>(std::chrono::high_resolution_clock::period::den);
+    *(uint64_t *)value = phsa::Timestamp::frequency();
     break;
   }
   case HSA_SYSTEM_INFO_SIGNAL_MAX_WAIT: {
@@ -87,7 +85,7 @@ hsa_status_t HSA_API hsa_system_get_info(hsa_system_info_t attribute,
     for (ExtensionRegistry::const_iterator I = ER.cbegin(), E = ER.cend();
          I != E; ++I) {
       Extension::Identifier Id = I->first;
-      *((uint8_t *)value) |= 1 << Id;
+      Ptr[Id / 8] |= 1 << (Id % 8);
     }
     break;
   }